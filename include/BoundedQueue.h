@@ -0,0 +1,52 @@
+#ifndef CLAYG_BOUNDEDQUEUE_H
+#define CLAYG_BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed-capacity queue between one producer thread and one consumer thread. push() and pop() never take a
+// lock, a full or empty queue makes the caller yield until the other thread has caught up.
+template <typename T>
+class BoundedQueue
+{
+    std::vector<T> m_slots;
+    // Number of values popped and pushed so far, on separate cache lines so that the two threads do not
+    // invalidate each other's line on every call
+    alignas(64) std::atomic<size_t> m_popped{0};
+    alignas(64) std::atomic<size_t> m_pushed{0};
+
+public:
+    explicit BoundedQueue(const size_t capacity) : m_slots(capacity)
+    {
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Producer only, waits while the queue is full
+    void push(T value)
+    {
+        const size_t pushed = m_pushed.load(std::memory_order_relaxed);
+        while (pushed - m_popped.load(std::memory_order_acquire) == m_slots.size())
+            std::this_thread::yield();
+        m_slots[pushed % m_slots.size()] = std::move(value);
+        m_pushed.store(pushed + 1, std::memory_order_release);
+    }
+
+    // Consumer only, waits while the queue is empty
+    T pop()
+    {
+        const size_t popped = m_popped.load(std::memory_order_relaxed);
+        while (m_pushed.load(std::memory_order_acquire) == popped)
+            std::this_thread::yield();
+        T value = std::move(m_slots[popped % m_slots.size()]);
+        m_popped.store(popped + 1, std::memory_order_release);
+        return value;
+    }
+};
+
+
+#endif //CLAYG_BOUNDEDQUEUE_H
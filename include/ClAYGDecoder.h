@@ -5,6 +5,8 @@
 #ifndef CLAYG_CLAYGDECODER_H
 #define CLAYG_CLAYGDECODER_H
 
+#include <chrono>
+#include <tuple>
 #include <utility>
 
 #include "UnionFindDecoder.h"
@@ -17,7 +19,80 @@ protected:
     int growth_rounds_ = 1;
     int current_round_ = 0;
     double cluster_lifetime_factor_ = 0;
-    std::shared_ptr<DecodingGraph> decoding_graph_;
+    // Number of layers of the ring buffer that is decoded on (see FlatDecodingGraph::ring_buffer()),
+    // 0 to decode on a copy of the whole graph
+    int window_ = 0;
+    std::shared_ptr<FlatDecodingGraph> decoding_graph_;
+
+    // Streaming state, kept between begin(), push_round() and finish()
+    int rounds_ = 0;
+    int step_ = 0;
+    int considered_up_to_round_ = 0;
+    int last_encountered_non_neutral_cluster_ = 0;
+    double growth_steps_ = 0;
+    double max_growth_steps_ = 0;
+    // Set once the last round was pushed or decoding stopped early, later rounds are ignored
+    bool stopped_ = false;
+    // Deadline mode: a round grows at most deadline_steps_ times, or only until deadline_ns_ nanoseconds have
+    // passed since push_round() was called (0 for no limit). Growth that did not fit is deferred to the next
+    // round and counted in growth_backlog_.
+    int deadline_steps_ = 0;
+    long long deadline_ns_ = 0;
+    int growth_backlog_ = 0;
+    std::chrono::steady_clock::time_point round_start_;
+    // Neutral clusters that clean() dissolves
+    std::vector<const Cluster*> retired_clusters_;
+    // Adaptive cluster lifetime: clean() keeps a neutral cluster only while it is reachable, see
+    // find_reachable_clusters(), instead of for a fixed number of rounds
+    bool adaptive_lifetime_ = false;
+    // First and last round of every cluster with its index in m_clusters, and of the rounds still to come with
+    // index -1
+    std::vector<std::tuple<int, int, int>> cluster_rounds_;
+    // Whether each cluster of m_clusters is reachable
+    std::vector<uint8_t> reachable_;
+
+    // Rounds a non-neutral cluster can grow across before it reaches the boundary, see find_reachable_clusters()
+    [[nodiscard]] long long reach(const FlatDecodingGraph& decoding_graph) const;
+    // Finds the neutral clusters that a non-neutral cluster or the defects of a future round could still grow into
+    void find_reachable_clusters(const FlatDecodingGraph& decoding_graph);
+
+    void reset_stream(int rounds);
+
+    // Starts the lifetime of a cluster that a merge left neutral
+    void merged(Cluster& cluster) override;
+
+    // Grows every non-neutral cluster once and merges the results, with stripes on the threads that own them
+    // and a boundary exchange for the clusters that cross stripe borders
+    void grow_and_merge();
+
+    [[nodiscard]] bool has_deadline() const { return deadline_steps_ > 0 || deadline_ns_ > 0; }
+
+    // Whether the current round has used up its deadline after growing `steps` times
+    [[nodiscard]] bool deadline_reached(int steps) const;
+
+    // Grows for this round and the rounds deferred before it until the deadline, see deadline_steps_
+    void grow_within_deadline();
+
+    // Grows until all clusters are neutral and peels them
+    DecodingResult grow_until_neutral_and_peel();
+
+    // Number of times the ring buffer was flushed since begin()
+    int window_flushes_ = 0;
+
+    // Grows until all clusters are neutral and peels all of them regardless of their lifetime, so that the
+    // ring buffer can recycle a round that a cluster still reaches into
+    DecodingResult flush_window();
+
+    virtual void begin_decoding(const FlatDecodingGraph& graph);
+
+    virtual void begin_decoding(const std::string& code_name, int d, int t);
+
+    // Clears the decoding graph and the stream for a shot of `t` rounds
+    void start_decoding(int t);
+
+    virtual DecodingResult process_round(const std::vector<DecodingGraphNode::Id>& defects);
+
+    virtual DecodingResult finish_decoding();
 
     [[nodiscard]] double growth_steps_fixed(const double current_growth_steps, const double peeling_growth_steps) const {
         double growth_steps = current_growth_steps + peeling_growth_steps;
@@ -30,27 +105,73 @@ protected:
 public:
     explicit ClAYGDecoder(const std::unordered_map<std::string, std::string>& args = {});
 
-    DecodingResult decode(std::shared_ptr<DecodingGraph> graph) override;
+    using Decoder::decode;
 
-    void merge(const std::vector<DecodingGraphEdge::FusionEdge>& fusion_edges) override;
+    // Streams the rounds of `graph` through begin(), push_round() and finish()
+    DecodingResult decode(FlatDecodingGraph& graph) override;
 
-    DecodingResult clean(const std::shared_ptr<DecodingGraph>& decoding_graph);
+    // Streaming interface: begin() prepares decoding a graph with the topology of `graph` (its marks are
+    // ignored), push_round() adds the defects of the next measurement round and returns the corrections
+    // peeled in that round, finish() grows and peels the remaining clusters. Corrections are edge indices
+    // into decoding_graph(), and every result reports the wall-clock latency of its call.
+    void begin(const FlatDecodingGraph& graph);
 
-    virtual void add(const std::shared_ptr<DecodingGraph>& graph, std::shared_ptr<DecodingGraphNode> node);
+    // Same as begin() for a graph of `t` rounds of `code_name`. With a window the graph of all `t` rounds is
+    // never built, so arbitrarily long streams are decoded in constant memory.
+    void begin(const std::string& code_name, int d, int t);
+
+    DecodingResult push_round(const std::vector<DecodingGraphNode::Id>& defects);
+
+    DecodingResult finish();
+
+    // Whether push_round() ignores further rounds, either because all rounds were pushed or decoding stopped early
+    [[nodiscard]] bool stopped() const { return stopped_; }
+
+    [[nodiscard]] const FlatDecodingGraph& decoding_graph() const { return *decoding_graph_; }
+
+    // Number of rounds since begin() in which the window was too short and all clusters had to be peeled
+    [[nodiscard]] int window_flushes() const { return window_flushes_; }
+
+    // Peels neutral clusters, those younger than the cluster lifetime only if keep_young_clusters is false
+    DecodingResult clean(FlatDecodingGraph& decoding_graph, bool keep_young_clusters = true);
+
+    virtual void add(FlatDecodingGraph& graph, DecodingGraphNode::Id id);
 
     void set_growth_rounds(const int growth_rounds) { growth_rounds_ = growth_rounds; }
 
     void set_cluster_lifetime_factor(const double life_time) { cluster_lifetime_factor_ = life_time; }
+
+    void set_adaptive_lifetime(const bool adaptive) { adaptive_lifetime_ = adaptive; }
+
+    void set_window(const int window) { window_ = window; }
+
+    void set_deadline_steps(const int steps) { deadline_steps_ = steps; }
+
+    void set_deadline_ns(const long long ns) { deadline_ns_ = ns; }
+
+    // Growth steps deferred to the next round by the deadline
+    [[nodiscard]] int growth_backlog() const { return growth_backlog_; }
 };
 
 class SingleLayerClAYGDecoder : public ClAYGDecoder
 {
+protected:
+    void begin_decoding(const FlatDecodingGraph& graph) override;
+
+    void begin_decoding(const std::string& code_name, int d, int t) override;
+
+    DecodingResult process_round(const std::vector<DecodingGraphNode::Id>& defects) override;
+
+    DecodingResult finish_decoding() override;
+
 public:
     explicit SingleLayerClAYGDecoder(const std::unordered_map<std::string, std::string>& args = {});
 
-    DecodingResult decode(std::shared_ptr<DecodingGraph> graph) override;
+    using Decoder::decode;
+
+    DecodingResult decode(FlatDecodingGraph& graph) override;
 
-    void add(const std::shared_ptr<DecodingGraph>& graph, std::shared_ptr<DecodingGraphNode> node) override;
+    void add(FlatDecodingGraph& graph, DecodingGraphNode::Id id) override;
 };
 
 #endif //CLAYG_CLAYGDECODER_H
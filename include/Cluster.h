@@ -7,80 +7,204 @@
 
 #include <vector>
 #include <algorithm>
+#include <memory>
 #include <set>
 
-class DecodingGraphNode;
-class DecodingGraphEdge;
+#include "GrowthKernel.h"
 
+class FlatDecodingGraph;
+class ClusterPool;
+
+// Clusters refer to nodes and edges by their index in the FlatDecodingGraph they were grown on.
 class Cluster
 {
 public:
     struct BoundaryEdge
     {
-        std::shared_ptr<DecodingGraphNode> tree_node;
-        std::shared_ptr<DecodingGraphNode> leaf_node;
-        std::shared_ptr<DecodingGraphEdge> edge;
-        mutable float growth_from_tree = 0;
+        int tree_node;
+        int leaf_node;
+        int edge;
+        Growth growth_from_tree = 0;
+    };
+
+    // Boundary as a structure of arrays, so a growth step can run over the edges and their growth in bulk.
+    // Entry i is edges[i] from tree_nodes[i] inside the cluster to leaf_nodes[i] outside of it. ranks[i] is
+    // the position of the entry in the order fusion edges are reported in, see merge().
+    struct Boundary
+    {
+        std::vector<int> tree_nodes;
+        std::vector<int> leaf_nodes;
+        std::vector<int> edges;
+        std::vector<Growth> growth_from_tree;
+        std::vector<long long> ranks;
+
+        [[nodiscard]] int size() const { return static_cast<int>(edges.size()); }
+
+        [[nodiscard]] BoundaryEdge operator[](const int i) const
+        {
+            return {tree_nodes[i], leaf_nodes[i], edges[i], growth_from_tree[i]};
+        }
+
+        void reserve(const int capacity)
+        {
+            tree_nodes.reserve(capacity);
+            leaf_nodes.reserve(capacity);
+            edges.reserve(capacity);
+            growth_from_tree.reserve(capacity);
+            ranks.reserve(capacity);
+        }
+
+        void push_back(const BoundaryEdge& boundary_edge, const long long rank)
+        {
+            tree_nodes.push_back(boundary_edge.tree_node);
+            leaf_nodes.push_back(boundary_edge.leaf_node);
+            edges.push_back(boundary_edge.edge);
+            growth_from_tree.push_back(boundary_edge.growth_from_tree);
+            ranks.push_back(rank);
+        }
+
+        // Appends the entries of `other` with their ranks shifted by `rank_shift`
+        void append(const Boundary& other, const long long rank_shift)
+        {
+            tree_nodes.insert(tree_nodes.end(), other.tree_nodes.begin(), other.tree_nodes.end());
+            leaf_nodes.insert(leaf_nodes.end(), other.leaf_nodes.begin(), other.leaf_nodes.end());
+            edges.insert(edges.end(), other.edges.begin(), other.edges.end());
+            growth_from_tree.insert(growth_from_tree.end(), other.growth_from_tree.begin(),
+                                    other.growth_from_tree.end());
+            for (const long long rank : other.ranks)
+                ranks.push_back(rank + rank_shift);
+        }
     };
 
 private:
-    std::shared_ptr<DecodingGraphNode> m_root;
-    std::vector<std::shared_ptr<DecodingGraphNode>> m_nodes;
-    std::vector<std::shared_ptr<DecodingGraphNode>> m_marked_nodes;
-    std::vector<std::shared_ptr<DecodingGraphNode>> m_virtual_nodes;
-    std::vector<std::shared_ptr<DecodingGraphEdge>> m_bulk_edges;
-    std::vector<BoundaryEdge> m_boundary;
+    int m_root;
+    // Node peeling starts from, see peel_start()
+    int m_peel_start;
+    std::vector<int> m_nodes;
+    std::vector<int> m_bulk_edges;
+    Boundary m_boundary;
+    // Ranks of the boundary lie in [m_first_rank, m_next_rank)
+    long long m_first_rank = 0;
+    long long m_next_rank = 0;
+    int m_marked_count = 0;
+    int m_virtual_count = 0;
+    // Measurement rounds spanned by the ancillas of the cluster
+    int m_first_round = 0;
+    int m_last_round = 0;
+    // Position in the owning decoder's cluster list, allows removing the cluster in O(1)
+    int m_index = -1;
+    // Order in which the clusters were created, see sequence()
+    long long m_sequence = 0;
 
     int m_has_been_neutral_since = -1;
+    // Capacity of the vectors when the cluster was returned to its pool (see ClusterPool)
+    std::size_t m_pooled_capacity = 0;
+
+    friend class ClusterPool;
+
+    // Turns the cluster into a new cluster consisting only of `root`, keeping the capacity of its vectors
+    void reset(int root, const FlatDecodingGraph& graph);
+
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return m_nodes.capacity() + m_bulk_edges.capacity() + m_boundary.tree_nodes.capacity()
+            + m_boundary.leaf_nodes.capacity() + m_boundary.edges.capacity() + m_boundary.growth_from_tree.capacity()
+            + m_boundary.ranks.capacity();
+    }
 
 public:
-    explicit Cluster(std::shared_ptr<DecodingGraphNode> root);
+    Cluster(int root, const FlatDecodingGraph& graph);
 
-    void add_node(const std::shared_ptr<DecodingGraphNode>& node)
+    void add_node(const int node)
     {
         m_nodes.push_back(node);
     }
 
-    void add_marked_node(const std::shared_ptr<DecodingGraphNode>& node)
+    void add_marked_node()
     {
-        m_marked_nodes.push_back(node);
+        m_marked_count++;
     }
 
-    void add_virtual_node(const std::shared_ptr<DecodingGraphNode>& node)
+    // Peeling starts from the first virtual node that joins a cluster
+    void add_virtual_node(const int node)
     {
-        m_virtual_nodes.push_back(node);
+        if (m_virtual_count++ == 0)
+            m_peel_start = node;
     }
 
-    void remove_marked_node(const std::shared_ptr<DecodingGraphNode>& node)
+    void remove_marked_node()
     {
-        m_marked_nodes.erase(std::remove(m_marked_nodes.begin(), m_marked_nodes.end(), node), m_marked_nodes.end());
+        m_marked_count--;
     }
 
-    void add_bulk_edge(const std::shared_ptr<DecodingGraphEdge>& edge)
+    // Extends the rounds spanned by the cluster to `round`, the round of an ancilla that joined it
+    void add_round(const int round)
+    {
+        m_first_round = std::min(m_first_round, round);
+        m_last_round = std::max(m_last_round, round);
+    }
+
+    void add_bulk_edge(const int edge)
     {
         m_bulk_edges.push_back(edge);
     }
 
     void add_boundary_edge(const BoundaryEdge& boundary_edge)
     {
-        m_boundary.push_back(boundary_edge);
+        m_boundary.push_back(boundary_edge, m_next_rank++);
     }
 
-    std::weak_ptr<DecodingGraphNode> root() { return m_root; }
+    // Moves all nodes, edges and counters of `other` into this cluster. `other_first` tells that `other` is the
+    // cluster of the tree node of the fusion edge: the merged cluster then takes its sequence number and peeling
+    // start, and ranks its boundary edges first, as if `other` had absorbed this cluster. Only the smaller
+    // boundary of `other` is copied and re-ranked either way.
+    void merge(Cluster& other, bool other_first = false);
+
+    [[nodiscard]] int root() const { return m_root; }
+
+    // The first virtual node that joined the cluster, or else the first node it was grown from. It does not
+    // depend on which of two merged clusters survives, see merge().
+    [[nodiscard]] int peel_start() const { return m_peel_start; }
+
+    [[nodiscard]] int size() const { return static_cast<int>(m_nodes.size()); }
+
+    [[nodiscard]] int marked_count() const { return m_marked_count; }
+
+    [[nodiscard]] int first_round() const { return m_first_round; }
+
+    [[nodiscard]] int last_round() const { return m_last_round; }
+
+    [[nodiscard]] int index() const { return m_index; }
+    void set_index(const int index) { m_index = index; }
+
+    // Clusters are grown and peeled in the order of their sequence number, which a merge takes from the cluster
+    // of the tree node, so the order of the fusion edges and corrections does not depend on which of two merged
+    // clusters survives or where clusters sit in the decoder's list
+    [[nodiscard]] long long sequence() const { return m_sequence; }
+    void set_sequence(const long long sequence) { m_sequence = sequence; }
+
+    [[nodiscard]] const std::vector<int>& nodes() const { return m_nodes; }
 
-    std::vector<std::shared_ptr<DecodingGraphNode>> nodes() { return m_nodes; }
-    std::vector<std::shared_ptr<DecodingGraphNode>> marked_nodes() { return m_marked_nodes; }
+    [[nodiscard]] const std::vector<int>& edges() const { return m_bulk_edges; }
 
-    std::vector<std::shared_ptr<DecodingGraphEdge>> edges() { return m_bulk_edges; }
+    [[nodiscard]] const Boundary& boundary() const { return m_boundary; }
+    // Growth steps record the growth each edge got from this cluster in place
+    Boundary& boundary() { return m_boundary; }
 
-    std::vector<BoundaryEdge> boundary() { return m_boundary; }
-    void set_boundary(const std::vector<BoundaryEdge>& boundary) { m_boundary = boundary; }
+    // Drops boundary edges whose leaf node has joined this cluster since they were added, which also removes
+    // the second copy of an edge that both of its endpoints contributed. The dropped edges are appended to
+    // `dropped`, the caller has to take the growth they got from this cluster back from the graph. Edges the
+    // leaf node joined through are kept, they keep growing and peeling the cluster takes their growth back
+    // from the bulk edges, as without compaction.
+    // With a const graph it only reads the graph, so clusters can be compacted concurrently.
+    template <typename Graph>
+    void compact_boundary(Graph& graph, std::vector<BoundaryEdge>& dropped);
 
     bool is_neutral(bool consider_virtual_nodes = true) const;
     int has_been_neutral_since() const { return m_has_been_neutral_since; }
     void set_has_been_neutral_since(int round) { m_has_been_neutral_since = round; }
 
-    static bool all_clusters_are_neutral(std::vector<std::shared_ptr<Cluster>> clusters,
+    static bool all_clusters_are_neutral(const std::vector<std::shared_ptr<Cluster>>& clusters,
                                          bool consider_virtual_nodes = true);
 };
 
@@ -0,0 +1,42 @@
+#ifndef CLAYG_CLUSTERPOOL_H
+#define CLAYG_CLUSTERPOOL_H
+
+#include <memory>
+#include <vector>
+
+#include "Cluster.h"
+
+// Clusters of one decoder. Clusters that were merged away or dissolved are handed out again, together with the
+// capacity of their vectors, so once the decoder has seen its largest shots it hardly allocates.
+// Not thread-safe, every decoder owns its own pool.
+class ClusterPool
+{
+public:
+    struct Stats
+    {
+        long long shots = 0;
+        long long clusters = 0;
+        // Clusters that had to be created, and clusters that came back with more capacity than they were
+        // handed out with, i.e. whose vectors had to allocate
+        long long allocations = 0;
+    };
+
+private:
+    std::vector<std::shared_ptr<Cluster>> m_free;
+    Stats m_stats;
+
+public:
+    // A cluster consisting only of `root`
+    std::shared_ptr<Cluster> acquire(int root, const FlatDecodingGraph& graph);
+
+    // Takes back a cluster that is no longer referenced by the decoder or the graph
+    void release(std::shared_ptr<Cluster> cluster);
+
+    // Takes back all of `clusters` at the start of a shot and clears the list
+    void release_all(std::vector<std::shared_ptr<Cluster>>& clusters);
+
+    [[nodiscard]] const Stats& stats() const { return m_stats; }
+};
+
+
+#endif //CLAYG_CLUSTERPOOL_H
@@ -5,11 +5,13 @@
 #ifndef CLAYG_DECODER_H
 #define CLAYG_DECODER_H
 
+#include <map>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
 
 // Type to represent decoding results: pair<vector of error edges, int number of rounds considered>
 struct DecodingResult {
@@ -19,6 +21,18 @@ struct DecodingResult {
     // Decoding step at which each correction in `corrections` arrived (parallel to
     // `corrections`). Empty if the decoder does not track arrival steps.
     std::vector<int> correction_steps;
+    // Corrections as edge indices into the FlatDecodingGraph that was decoded. Decoders only fill
+    // these; `corrections` is resolved from them when decoding a DecodingGraph.
+    std::vector<int> correction_indices;
+    // Wall-clock time in seconds spent in the call that produced this result
+    double latency = 0;
+    // Latency of every round of a streaming decoder (see ClAYGDecoder::push_round), the final
+    // ClAYGDecoder::finish() is the last entry. Empty for decoders that do not stream.
+    std::vector<double> round_latencies;
+    // Growth steps a decoder with a per-round deadline (see ClAYGDecoder) deferred to later rounds, as of the
+    // end of this call, and as of the end of every round when streaming. Empty for decoders without a deadline.
+    int backlog = 0;
+    std::vector<int> round_backlogs;
 };
 
 class Decoder {
@@ -27,9 +41,17 @@ public:
 
     virtual ~Decoder() = default;
 
-    virtual DecodingResult decode(std::shared_ptr<DecodingGraph> graph) {
-        return {};
-    };
+    // Decodes the flat view of `graph` and resolves the corrections to edges of `graph`.
+    virtual DecodingResult decode(std::shared_ptr<DecodingGraph> graph);
+
+    // Decodes the marked nodes of `graph`, the corrections are edge indices into `graph`
+    virtual DecodingResult decode(FlatDecodingGraph& graph) = 0;
+
+    // Error rate and noise model (factor of p per edge type) of the shots decoded next, for decoders that
+    // weigh edges by their error probability
+    virtual void set_noise(double, const std::map<DecodingGraphEdge::Type, double>&)
+    {
+    }
 
     virtual void dump(const std::string& filename)
     {
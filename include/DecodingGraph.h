@@ -13,14 +13,13 @@
 #include <set>
 #include <cassert>
 #include <string>
-#include <random>
 
-#include "Cluster.h"
-
-class Cluster;
+#include "RandomStream.h"
 
 class DecodingGraphEdge;
 
+class FlatDecodingGraph;
+
 class DecodingGraphNode;
 
 
@@ -53,9 +52,9 @@ public:
 
 private:
     Id m_id;
+    int m_index = -1;
 
     bool m_marked = false;
-    std::optional<std::weak_ptr<Cluster>> m_cluster;
     std::vector<std::weak_ptr<DecodingGraphEdge>> m_edges;
 
 public:
@@ -65,13 +64,14 @@ public:
 
     Id id() { return m_id; }
 
-    [[nodiscard]] bool marked() const { return m_marked; }
+    // Position of the node in DecodingGraph::nodes(), i.e. its index in the FlatDecodingGraph
+    [[nodiscard]] int index() const { return m_index; }
 
-    void set_marked(const bool marked) { m_marked = marked; }
+    void set_index(const int index) { m_index = index; }
 
-    std::optional<std::weak_ptr<Cluster>> cluster() { return m_cluster; }
+    [[nodiscard]] bool marked() const { return m_marked; }
 
-    void set_cluster(const std::optional<std::weak_ptr<Cluster>>& cluster) { m_cluster = cluster; }
+    void set_marked(const bool marked) { m_marked = marked; }
 
     std::vector<std::weak_ptr<DecodingGraphEdge>> edges() { return m_edges; }
 
@@ -95,23 +95,17 @@ public:
         int id;
     };
 
-    struct FusionEdge
-    {
-        std::shared_ptr<DecodingGraphEdge> edge;
-        std::shared_ptr<DecodingGraphNode> tree_node;
-        std::shared_ptr<DecodingGraphNode> leaf_node;
-    };
-
 private:
     Id m_id;
+    int m_index = -1;
     std::pair<std::weak_ptr<DecodingGraphNode>, std::weak_ptr<DecodingGraphNode>> m_nodes;
-    float m_growth, m_weight;
+    float m_weight;
 
 public:
     explicit DecodingGraphEdge(const Id id,
                                std::pair<std::weak_ptr<DecodingGraphNode>, std::weak_ptr<DecodingGraphNode>> nodes = {},
-                               float growth = 0, float weight = 1)
-        : m_id(id), m_nodes(std::move(nodes)), m_growth(growth), m_weight(weight)
+                               float weight = 1)
+        : m_id(id), m_nodes(std::move(nodes)), m_weight(weight)
     {
     };
 
@@ -121,6 +115,11 @@ public:
 
     [[nodiscard]] float weight() const { return m_weight; }
 
+    // Position of the edge in DecodingGraph::edges(), i.e. its index in the FlatDecodingGraph
+    [[nodiscard]] int index() const { return m_index; }
+
+    void set_index(const int index) { m_index = index; }
+
     std::pair<std::weak_ptr<DecodingGraphNode>, std::weak_ptr<DecodingGraphNode>> nodes() { return m_nodes; }
 
     std::weak_ptr<DecodingGraphNode> other_node(const std::weak_ptr<DecodingGraphNode>& node)
@@ -129,11 +128,6 @@ public:
         if (node.lock() == m_nodes.second.lock()) return m_nodes.first;
         assert(false && "Node not in edge");
     }
-
-    [[nodiscard]] float growth() const { return m_growth; }
-
-    void add_growth(const float growth) { m_growth += growth; }
-    void reset_growth() { m_growth = 0; }
 };
 
 inline void operator++(DecodingGraphEdge::Id& id, int)
@@ -153,6 +147,19 @@ class DecodingGraph
     std::vector<std::map<int, std::shared_ptr<DecodingGraphEdge>>> m_normal_edges;
     std::vector<std::map<int, std::shared_ptr<DecodingGraphEdge>>> m_measurement_edges;
     std::vector<DecodingGraphEdge::Id> m_logical_edges;
+    std::shared_ptr<FlatDecodingGraph> m_flat;
+    // Indices of the nodes whose mark was flipped by mark() since the last reset()
+    std::vector<int> m_marked_nodes;
+    // Edges in sampling order (per round: normal edges, then measurement edges), see build_sampling_order().
+    // The edges of rounds < t are m_sampling_edges[0] ... m_sampling_edges[m_sampling_round_end[t]-1].
+    std::vector<DecodingGraphEdge::Id> m_sampling_edges;
+    std::vector<int> m_sampling_round_end;
+
+    // Calls on_error(i, lane) for every faulty (edge, realisation) pair of `lanes` independent realisations,
+    // where i indexes m_sampling_edges
+    template <typename OnError>
+    void sample_faults(double p, const std::map<DecodingGraphEdge::Type, double>& noise_model, int sample_T,
+                       int lanes, RandomStream& rng, OnError on_error) const;
 
 public:
     DecodingGraph() : m_ancilla_nodes({}), m_virtual_nodes({}), m_edges({})
@@ -163,6 +170,8 @@ public:
     static std::shared_ptr<DecodingGraph> rotated_surface_code(int D, int T);
     static std::shared_ptr<DecodingGraph> repetition_code(int D, int T);
     static std::shared_ptr<DecodingGraph> single_layer_copy(std::shared_ptr<DecodingGraph> source);
+    // Dispatches to one of the factories above by its code_name()
+    static std::shared_ptr<DecodingGraph> from_code_name(const std::string& code_name, int D, int T);
 
     [[nodiscard]] int ancilla_count_per_layer() const { return m_ancilla_count_per_layer; }
 
@@ -176,13 +185,30 @@ public:
 
     std::vector<std::shared_ptr<DecodingGraphEdge>> edges() { return m_edges; }
 
+    // CSR view of this graph, built on first use. Marks set through mark()/reset() are mirrored into it.
+    std::shared_ptr<FlatDecodingGraph> flat();
+
     // Sample errors using a per-edge-type multiplier map. If sample_T < 0 the graph's T is used.
+    // Jumps from one faulty edge candidate to the next with geometrically distributed skips, so the cost
+    // scales with the number of errors rather than with the number of edges.
     std::vector<DecodingGraphEdge::Id> sample_errors(
         double p,
         const std::map<DecodingGraphEdge::Type, double>& noise_model,
         int sample_T,
-        std::uniform_real_distribution<double>& dis,
-        std::mt19937& gen) const;
+        RandomStream& rng) const;
+
+    // Samples 64 independent realisations of sample_errors() at once. Returns every edge that is faulty in
+    // at least one realisation, together with the bit mask of the realisations it is faulty in.
+    std::vector<std::pair<DecodingGraphEdge::Id, uint64_t>> sample_error_batch(
+        double p,
+        const std::map<DecodingGraphEdge::Type, double>& noise_model,
+        int sample_T,
+        RandomStream& rng) const;
+
+    // Builds the order in which sample_errors() visits the edges. The code factories call it, so sampling never
+    // writes to a graph that is shared between threads. Graphs assembled with addEdge() have to call it after
+    // their last edge.
+    void build_sampling_order();
 
     void addNode(const std::shared_ptr<DecodingGraphNode>& node);
 
@@ -194,8 +220,13 @@ public:
 
     std::set<int> logical_edge_ids();
 
+    [[nodiscard]] const std::vector<DecodingGraphEdge::Id>& logical_edges() const { return m_logical_edges; }
+
     std::optional<std::shared_ptr<DecodingGraphEdge>> edge(DecodingGraphEdge::Id id);
 
+    const std::shared_ptr<DecodingGraphEdge>& edge_at(const int index) const { return m_edges[index]; }
+
+    // Undoes mark() and everything decoders did on flat(), visiting only the nodes and edges they touched
     void reset();
 
     void mark(const std::vector<std::shared_ptr<DecodingGraphEdge>>& error_edges);
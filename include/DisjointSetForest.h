@@ -0,0 +1,73 @@
+#ifndef CLAYG_DISJOINTSETFOREST_H
+#define CLAYG_DISJOINTSETFOREST_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// Disjoint-set forest over dense element indices with union-by-size and path compression.
+// Elements start outside of the forest and have to be added with make_set() before use.
+class DisjointSetForest
+{
+    std::vector<int> m_parent; // -1 if the element is not part of any set
+    std::vector<int> m_size;   // only meaningful for roots
+
+public:
+    explicit DisjointSetForest(const int size = 0) : m_parent(size, -1), m_size(size, 0)
+    {
+    }
+
+    [[nodiscard]] bool contains(const int x) const { return m_parent[x] != -1; }
+
+    void make_set(const int x)
+    {
+        m_parent[x] = x;
+        m_size[x] = 1;
+    }
+
+    int find(int x)
+    {
+        int root = x;
+        while (m_parent[root] != root)
+            root = m_parent[root];
+        while (m_parent[x] != root)
+        {
+            const int next = m_parent[x];
+            m_parent[x] = root;
+            x = next;
+        }
+        return root;
+    }
+
+    // Same as find() without path compression, so it can be called concurrently
+    [[nodiscard]] int root(int x) const
+    {
+        while (m_parent[x] != x)
+            x = m_parent[x];
+        return x;
+    }
+
+    // Unites the sets of a and b by attaching the smaller tree below the larger one. Returns the new root.
+    int unite(const int a, const int b)
+    {
+        int root_a = find(a);
+        int root_b = find(b);
+        if (root_a == root_b)
+            return root_a;
+        if (m_size[root_a] < m_size[root_b])
+            std::swap(root_a, root_b);
+        m_parent[root_b] = root_a;
+        m_size[root_a] += m_size[root_b];
+        return root_a;
+    }
+
+    [[nodiscard]] int size(const int root) const { return m_size[root]; }
+
+    // Takes x out of the forest. Only valid if every other element of its set is removed as well.
+    void remove(const int x) { m_parent[x] = -1; }
+
+    void reset() { std::ranges::fill(m_parent, -1); }
+};
+
+
+#endif //CLAYG_DISJOINTSETFOREST_H
@@ -0,0 +1,397 @@
+#ifndef CLAYG_FLATDECODINGGRAPH_H
+#define CLAYG_FLATDECODINGGRAPH_H
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "DecodingGraph.h"
+#include "DisjointSetForest.h"
+#include "GrowthKernel.h"
+
+class Cluster;
+
+// Compressed-sparse-row representation of a DecodingGraph.
+// Nodes and edges are addressed by contiguous integer indices (the position of the node/edge in
+// DecodingGraph::nodes()/edges()), and all mutable decoding state lives in parallel arrays, so
+// decoders can traverse the graph without touching any shared_ptr/weak_ptr.
+class FlatDecodingGraph
+{
+public:
+    struct FusionEdge
+    {
+        int edge;
+        int tree_node;
+        int leaf_node;
+    };
+
+private:
+    // Everything but the decoding state. It never changes once built, so graphs of the same code share it and
+    // only own their state arrays (see overlay()).
+    struct Topology
+    {
+        int ancilla_count_per_layer = 0, d = 0, t = 0;
+        std::string code_name;
+        std::vector<DecodingGraphNode::Id> node_ids;
+        std::vector<DecodingGraphEdge::Id> edge_ids;
+        std::vector<std::pair<int, int>> edge_nodes;
+        std::vector<int> offsets;
+        std::vector<int> adjacent_edges;
+        std::vector<int> adjacent_nodes;
+        std::vector<int> logical_edges;
+        std::vector<int> virtual_node_index;
+        int ancilla_stride = 0;
+        std::vector<int> ancilla_node_index;
+        int normal_edge_stride = 0;
+        std::vector<int> normal_edge_index;
+        int measurement_edge_stride = 0;
+        std::vector<int> measurement_edge_index;
+        // Weights of the DecodingGraph edges in growth units
+        std::vector<Growth> weights;
+        // Largest difference between the ids of two ancillas that share an edge, see has_row_bands()
+        int ancilla_span = 0;
+        // Ring buffers only, see ring_buffer()
+        int layers = 0;
+        std::vector<std::vector<int>> layer_nodes;
+        std::vector<std::vector<int>> layer_edges;
+        int lookahead = 0;
+
+        // Index of the edge with `id` in a graph that is not a ring buffer, -1 if there is none
+        [[nodiscard]] int edge(const DecodingGraphEdge::Id& id) const;
+    };
+    std::shared_ptr<const Topology> m_topology;
+
+    // Copies of the scalars and views of the arrays of m_topology, so that traversals index the arrays
+    // without going through m_topology first
+    int m_ancilla_count_per_layer = 0, D = 0, T = 0;
+    std::span<const DecodingGraphNode::Id> m_node_ids;
+    std::span<const DecodingGraphEdge::Id> m_edge_ids;
+    std::span<const std::pair<int, int>> m_edge_nodes;
+    // Edges incident to node n are m_adjacent_edges[m_offsets[n]] ... m_adjacent_edges[m_offsets[n+1]-1],
+    // m_adjacent_nodes holds the node on the other end of each of them.
+    std::span<const int> m_offsets;
+    std::span<const int> m_adjacent_edges;
+    std::span<const int> m_adjacent_nodes;
+
+    // Id -> index lookup tables (-1 if there is no such node/edge)
+    std::span<const int> m_virtual_node_index;
+    int m_ancilla_stride = 0;
+    std::span<const int> m_ancilla_node_index;
+
+    static std::shared_ptr<Topology> build_topology(DecodingGraph& graph);
+
+    // Topology of `code_name` with `t` rounds, or of its ring buffer of `layers` layers, built once per process
+    static std::shared_ptr<const Topology> shared_topology(const std::string& code_name, int d, int t, int layers);
+
+    // Graph with its own, cleared state on `topology`
+    static std::shared_ptr<FlatDecodingGraph> with_topology(std::shared_ptr<const Topology> topology);
+
+    // State
+    std::vector<uint8_t> m_marked;
+    // The nodes of each cluster form one set of m_forest, m_cluster is only meaningful for its root
+    DisjointSetForest m_forest;
+    std::vector<Cluster*> m_cluster;
+    // Growth and weight in growth units, with one element of padding for the growth kernels
+    std::vector<Growth> m_growth;
+    std::vector<Growth> m_weight;
+    // Edges through which a node joined a cluster, see join_cluster()
+    std::vector<uint8_t> m_bulk_edge;
+    // Weights by edge type as last set by set_edge_weights(), edges of the DecodingGraph have weight 1
+    Growth m_normal_weight = GROWTH_UNITS;
+    Growth m_measurement_weight = GROWTH_UNITS;
+    // Nodes that were marked or joined a cluster and edges that received growth since the last reset(),
+    // so that reset() only has to undo what decoding touched
+    std::vector<int> m_dirty_nodes;
+    std::vector<uint8_t> m_node_dirty;
+    std::vector<int> m_dirty_edges;
+    std::vector<uint8_t> m_edge_dirty;
+
+    void touch_node(const int node)
+    {
+        if (!m_node_dirty[node])
+        {
+            m_node_dirty[node] = 1;
+            m_dirty_nodes.push_back(node);
+        }
+    }
+
+    void touch_edge(const int edge)
+    {
+        if (!m_edge_dirty[edge])
+        {
+            m_edge_dirty[edge] = 1;
+            m_dirty_edges.push_back(edge);
+        }
+    }
+
+    // Ring buffer state (see ring_buffer()), empty for ordinary graphs.
+    // Layer l holds round m_layer_round[l] of the stream, or no round at all if it is -1.
+    std::vector<int> m_layer_round;
+    // Weights of the edges while they are active, inactive edges have an UNREACHABLE_WEIGHT
+    std::vector<Growth> m_base_weight;
+    int m_stream_rounds = 0;
+
+    void update_weight(int edge);
+
+    // Layer that advance(round) recycles, -1 if it recycles none
+    [[nodiscard]] int recycled_layer(int round) const;
+
+public:
+    static std::shared_ptr<FlatDecodingGraph> from(DecodingGraph& graph);
+    // Graph that shares the topology of `source` and has its own, cleared state, e.g. the working graph of
+    // a decoder. Node and edge indices are the same as in `source`.
+    static std::shared_ptr<FlatDecodingGraph> overlay(const FlatDecodingGraph& source);
+    // Graph of `t` rounds of `code_name` with cleared state. Its topology is built once and shared by all
+    // graphs of the same code, distance and number of rounds.
+    static std::shared_ptr<FlatDecodingGraph> overlay(const std::string& code_name, int d, int t);
+    static std::shared_ptr<FlatDecodingGraph> single_layer_copy(const FlatDecodingGraph& source);
+    // Graph of `layers` rounds of `code_name` whose last layer is connected back to its first one. Each layer
+    // holds one round of a stream at a time and is recycled for a later round once its round has retired
+    // (see advance()), so streams of any length are decoded in constant memory. node_id()/edge_id() report
+    // rounds of the stream, and node()/edge() only resolve the rounds that are currently held. Throws if an
+    // edge of the code other than a measurement edge between two consecutive rounds spans rounds, such an
+    // edge would connect layers that hold unrelated rounds.
+    static std::shared_ptr<FlatDecodingGraph> ring_buffer(const std::string& code_name, int d, int layers);
+
+    [[nodiscard]] bool shares_topology(const FlatDecodingGraph& other) const
+    {
+        return m_topology == other.m_topology;
+    }
+
+    [[nodiscard]] int ancilla_count_per_layer() const { return m_ancilla_count_per_layer; }
+
+    [[nodiscard]] int d() const { return D; }
+
+    [[nodiscard]] int t() const { return T; }
+
+    [[nodiscard]] const std::string& code_name() const { return m_topology->code_name; }
+
+    [[nodiscard]] int node_count() const { return static_cast<int>(m_node_ids.size()); }
+
+    [[nodiscard]] int edge_count() const { return static_cast<int>(m_edge_ids.size()); }
+
+    [[nodiscard]] DecodingGraphNode::Id node_id(const int node) const
+    {
+        auto id = m_node_ids[node];
+        if (is_ring_buffer() && id.type == DecodingGraphNode::ANCILLA)
+            id.round = m_layer_round[id.round];
+        return id;
+    }
+
+    [[nodiscard]] DecodingGraphEdge::Id edge_id(const int edge) const
+    {
+        auto id = m_edge_ids[edge];
+        if (is_ring_buffer())
+            id.round = m_layer_round[id.round];
+        return id;
+    }
+
+    [[nodiscard]] bool is_virtual(const int node) const
+    {
+        return m_node_ids[node].type == DecodingGraphNode::VIRTUAL;
+    }
+
+    [[nodiscard]] DecodingGraphEdge::Type edge_type(const int edge) const { return m_edge_ids[edge].type; }
+
+    [[nodiscard]] std::pair<int, int> edge_nodes(const int edge) const { return m_edge_nodes[edge]; }
+
+    [[nodiscard]] int other_node(const int edge, const int node) const
+    {
+        return m_edge_nodes[edge].first == node ? m_edge_nodes[edge].second : m_edge_nodes[edge].first;
+    }
+
+    // Stripe of `edge` when every layer is split into `stripes` runs of consecutive ancillas, i.e. into bands
+    // of rows of the rotated surface code. An edge between two stripes belongs to the lower one.
+    [[nodiscard]] int stripe(const int edge, const int stripes) const
+    {
+        const auto [first, second] = m_edge_nodes[edge];
+        int ancilla = m_ancilla_count_per_layer - 1;
+        if (!is_virtual(first) && m_node_ids[first].id < ancilla)
+            ancilla = m_node_ids[first].id;
+        if (!is_virtual(second) && m_node_ids[second].id < ancilla)
+            ancilla = m_node_ids[second].id;
+        return ancilla * stripes / m_ancilla_count_per_layer;
+    }
+
+    // Whether splitting every layer into `stripes` runs of consecutive ancillas gives spatial bands, i.e. whether
+    // edges only connect ancillas of the same or of neighbouring stripes. True for the codes of DecodingGraph,
+    // which number ancillas row by row, as long as every stripe holds at least one row.
+    [[nodiscard]] bool has_row_bands(const int stripes) const
+    {
+        return stripes * m_topology->ancilla_span <= m_ancilla_count_per_layer;
+    }
+
+    // Stripe of `node` (see stripe()), -1 for virtual nodes, which border every stripe
+    [[nodiscard]] int node_stripe(const int node, const int stripes) const
+    {
+        return is_virtual(node) ? -1 : m_node_ids[node].id * stripes / m_ancilla_count_per_layer;
+    }
+
+    [[nodiscard]] std::span<const int> incident_edges(const int node) const
+    {
+        return {m_adjacent_edges.data() + m_offsets[node], m_adjacent_edges.data() + m_offsets[node + 1]};
+    }
+
+    [[nodiscard]] std::span<const int> neighbors(const int node) const
+    {
+        return {m_adjacent_nodes.data() + m_offsets[node], m_adjacent_nodes.data() + m_offsets[node + 1]};
+    }
+
+    [[nodiscard]] int node(DecodingGraphNode::Id id) const;
+
+    [[nodiscard]] int edge(DecodingGraphEdge::Id id) const;
+
+    [[nodiscard]] const std::vector<int>& logical_edges() const { return m_topology->logical_edges; }
+
+    [[nodiscard]] bool marked(const int node) const { return m_marked[node]; }
+
+    void set_marked(const int node, const bool marked)
+    {
+        touch_node(node);
+        m_marked[node] = marked;
+    }
+
+    // Same as set_marked() for a node of a cluster, which was touched when it joined the cluster. Threads
+    // that peel distinct clusters can call it concurrently.
+    void set_marked_concurrently(const int node, const bool marked) { m_marked[node] = marked; }
+
+    [[nodiscard]] Cluster* cluster(const int node)
+    {
+        return m_forest.contains(node) ? m_cluster[m_forest.find(node)] : nullptr;
+    }
+
+    // Does not compress paths of the cluster forest, so it can be called concurrently
+    [[nodiscard]] const Cluster* cluster(const int node) const
+    {
+        return m_forest.contains(node) ? m_cluster[m_forest.root(node)] : nullptr;
+    }
+
+    // Starts a new cluster consisting only of `node`
+    void add_cluster(const int node, Cluster* cluster)
+    {
+        touch_node(node);
+        m_forest.make_set(node);
+        m_cluster[node] = cluster;
+    }
+
+    // Adds `node`, which must not be in any cluster yet, to the cluster of `cluster_node` through `edge`, which
+    // becomes a bulk edge of that cluster
+    void join_cluster(const int node, const int cluster_node, const int edge)
+    {
+        const int root = m_forest.find(cluster_node);
+        touch_edge(edge);
+        m_bulk_edge[edge] = 1;
+        touch_node(node);
+        m_forest.make_set(node);
+        // A singleton is never larger than the set it joins, so `root` stays the root
+        m_forest.unite(root, node);
+    }
+
+    // Same as join_cluster(), but collects `node` in `joined_nodes` instead of recording it for reset(). Threads
+    // that join nodes to distinct clusters can call it concurrently, each with its own `joined_nodes`, which
+    // have to be passed to record_joined_nodes() afterwards.
+    void join_cluster_concurrently(const int node, const int cluster_node, const int edge,
+                                   std::vector<int>& joined_nodes)
+    {
+        const int root = m_forest.find(cluster_node);
+        // The edge has grown, so it is recorded for reset() already
+        m_bulk_edge[edge] = 1;
+        if (!m_node_dirty[node])
+        {
+            m_node_dirty[node] = 1;
+            joined_nodes.push_back(node);
+        }
+        m_forest.make_set(node);
+        m_forest.unite(root, node);
+    }
+
+    void record_joined_nodes(const std::vector<int>& joined_nodes)
+    {
+        m_dirty_nodes.insert(m_dirty_nodes.end(), joined_nodes.begin(), joined_nodes.end());
+    }
+
+    // Unites the clusters of a and b, the union is then represented by `cluster`
+    void unite_clusters(const int a, const int b, Cluster* cluster) { m_cluster[m_forest.unite(a, b)] = cluster; }
+
+    // Takes `node` out of its cluster. Only valid when the whole cluster is dissolved.
+    void remove_from_cluster(const int node) { m_forest.remove(node); }
+
+    // Whether a node joined its cluster through `edge`
+    [[nodiscard]] bool is_bulk_edge(const int edge) const { return m_bulk_edge[edge]; }
+
+    // Takes `edge` out of the bulk of its cluster. Only valid when the whole cluster is dissolved.
+    void remove_bulk_edge(const int edge) { m_bulk_edge[edge] = 0; }
+
+    // Growth and weight are in units of 1 / GROWTH_UNITS
+    [[nodiscard]] Growth growth(const int edge) const { return m_growth[edge]; }
+
+    void add_growth(const int edge, const Growth growth)
+    {
+        touch_edge(edge);
+        m_growth[edge] = static_cast<Growth>(m_growth[edge] + growth);
+    }
+
+    // Adds increments[i] to the growth of each of `count` distinct edges and sets bit i of `fused` if edges[i]
+    // has grown to its weight, see GrowthKernel::grow()
+    void add_growth(const int* edges, const Growth* increments, int count, Growth* growth_from_tree, uint64_t* fused)
+    {
+        for (int i = 0; i < count; i++)
+            touch_edge(edges[i]);
+        GrowthKernel::grow(edges, increments, count, m_growth.data(), m_weight.data(), growth_from_tree, fused);
+    }
+
+    void reset_growth(const int edge) { m_growth[edge] = 0; }
+
+    // Same as add_growth(), but collects newly grown edges in `grown_edges` instead of recording them for reset().
+    // Threads that grow disjoint sets of edges can call it concurrently, each with its own `grown_edges`, which
+    // have to be passed to record_grown_edges() afterwards.
+    void add_growth_concurrently(const int edge, const Growth growth, std::vector<int>& grown_edges)
+    {
+        if (!m_edge_dirty[edge])
+        {
+            m_edge_dirty[edge] = 1;
+            grown_edges.push_back(edge);
+        }
+        m_growth[edge] = static_cast<Growth>(m_growth[edge] + growth);
+    }
+
+    void record_grown_edges(const std::vector<int>& grown_edges)
+    {
+        m_dirty_edges.insert(m_dirty_edges.end(), grown_edges.begin(), grown_edges.end());
+    }
+
+    [[nodiscard]] Growth weight(const int edge) const { return m_weight[edge]; }
+
+    // Gives every edge the weight of its type, e.g. log-likelihood weights of the noise model. Only visits
+    // the edges if the weights change.
+    void set_edge_weights(Growth normal, Growth measurement);
+
+    // Whether the ancilla endpoints of `edge` hold the rounds it connects. Always true unless the graph is a
+    // ring buffer, inactive edges have an UNREACHABLE_WEIGHT and must not be peeled.
+    [[nodiscard]] bool edge_active(int edge) const;
+
+    // Clears marks, clusters and growth. Only visits the nodes and edges touched since the last reset().
+    void reset();
+
+    void mark(const std::vector<int>& error_edges);
+
+    [[nodiscard]] std::vector<std::vector<int>> marked_nodes_by_round() const;
+
+    [[nodiscard]] bool is_ring_buffer() const { return !m_layer_round.empty(); }
+
+    // Ring buffer only: assigns the first rounds of a stream of `rounds` rounds to the layers
+    void start_stream(int rounds);
+
+    // Whether advance(round) would recycle a round that is still part of a cluster or grown towards
+    [[nodiscard]] bool recycling_blocked(int round) const;
+
+    // Ring buffer only: to be called before the defects of `round` are added. Recycles the layer of the
+    // oldest round for the round that is lookahead rounds ahead of `round`. Throws if recycling_blocked().
+    void advance(int round);
+};
+
+
+#endif //CLAYG_FLATDECODINGGRAPH_H
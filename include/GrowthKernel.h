@@ -0,0 +1,41 @@
+#ifndef CLAYG_GROWTHKERNEL_H
+#define CLAYG_GROWTHKERNEL_H
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+// Growth is counted in integer units, an edge of weight 1 is GROWTH_UNITS units long. 60 is the least common
+// multiple of 2, 3, 4, 5, 6, 10 and 12, so halves, thirds, quarters, fifths, sixths, tenths and twelfths of an
+// edge add up exactly and whether an edge has fused never depends on rounding. Weights of up to 546 edges
+// still fit into 16 bits.
+using Growth = int16_t;
+constexpr Growth GROWTH_UNITS = 60;
+// Weight of edges that never fuse, e.g. the inactive edges of a ring buffer
+constexpr Growth UNREACHABLE_WEIGHT = std::numeric_limits<Growth>::max();
+
+// Adds the growth of one step to a cluster boundary stored as a structure of arrays. There are AVX-512, AVX2
+// and scalar versions of the kernel, the widest one the CPU supports is picked at startup unless another
+// one is selected. All of them give the same results as adding the growth edge by edge.
+namespace GrowthKernel
+{
+// Whether `name` ("auto", "avx512", "avx2" or "scalar") is a kernel this CPU can run
+bool is_supported(const std::string& name);
+
+// Selects the kernel used by grow(), `name` has to be supported. Not thread-safe, call it before decoding.
+void select(const std::string& name);
+
+// Name of the selected kernel, "auto" resolved
+const char* selected();
+
+// For every entry i < count: adds increments[i] to growth[edges[i]] and to growth_from_tree[i], and sets
+// bit i of `fused` if growth[edges[i]] has reached weight[edges[i]]. `fused` needs (count + 63) / 64
+// zeroed words. The edges must be distinct, which the compacted boundary of a cluster guarantees.
+// The vector kernels load two adjacent entries of `growth` and `weight` at once, so both arrays need one
+// element of padding after the last edge.
+void grow(const int* edges, const Growth* increments, int count, Growth* growth, const Growth* weight,
+          Growth* growth_from_tree, uint64_t* fused);
+}
+
+
+#endif //CLAYG_GROWTHKERNEL_H
@@ -0,0 +1,56 @@
+#ifndef CLAYG_GROWTHPOLICY_H
+#define CLAYG_GROWTHPOLICY_H
+
+#include <variant>
+
+#include "DecodingGraph.h"
+#include "GrowthKernel.h"
+
+// Growth policies give the growth a cluster adds to one of its boundary edges in a growth step, in units of
+// GROWTH_UNITS per unit of weight, from the node inside the cluster (start), the node outside of it (end)
+// and the type of the edge.
+// UnionFindDecoder::grow() is instantiated for every policy, so the policy is inlined into its loop.
+
+struct UniformGrowth
+{
+    Growth operator()(const DecodingGraphNode::Id&, const DecodingGraphNode::Id&, DecodingGraphEdge::Type) const
+    {
+        return GROWTH_UNITS / 2;
+    }
+};
+
+struct ThirdGrowth
+{
+    Growth operator()(const DecodingGraphNode::Id&, const DecodingGraphNode::Id&, DecodingGraphEdge::Type) const
+    {
+        return GROWTH_UNITS / 3;
+    }
+};
+
+// Grows twice as fast towards earlier rounds
+struct FasterBackwardsGrowth
+{
+    Growth operator()(const DecodingGraphNode::Id& start, const DecodingGraphNode::Id& end,
+                      DecodingGraphEdge::Type) const
+    {
+        return start.round > end.round ? GROWTH_UNITS : GROWTH_UNITS / 2;
+    }
+};
+
+// Separate growth for normal and measurement edges, e.g. growth_policy=normal=0.5,measurement=0.25
+struct TypeWeightedGrowth
+{
+    Growth normal = GROWTH_UNITS / 2;
+    Growth measurement = GROWTH_UNITS / 2;
+
+    Growth operator()(const DecodingGraphNode::Id&, const DecodingGraphNode::Id&,
+                      const DecodingGraphEdge::Type edge_type) const
+    {
+        return edge_type == DecodingGraphEdge::NORMAL ? normal : measurement;
+    }
+};
+
+using GrowthPolicy = std::variant<UniformGrowth, ThirdGrowth, FasterBackwardsGrowth, TypeWeightedGrowth>;
+
+
+#endif //CLAYG_GROWTHPOLICY_H
@@ -5,6 +5,7 @@
 #include <memory>
 
 #include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
 #include "Cluster.h"
 
 class Logger {
@@ -22,13 +23,15 @@ public:
     static void clear_files_by_pattern(const std::string& dir, const std::string& pattern);
 
     // Structured logging APIs (no filename/directory args)
-    void log_decoding_step(const std::vector<std::shared_ptr<Cluster>>& clusters, const std::string& decoder, int step, int current_round = -1) const;
+    void log_decoding_step(const FlatDecodingGraph& graph, const std::vector<std::shared_ptr<Cluster>>& clusters, const std::string& decoder, int step, int current_round = -1) const;
     void log_graph(const std::shared_ptr<DecodingGraph>& graph) const;
     void log_errors(const std::vector<DecodingGraphEdge::Id>& error_ids) const;
     void log_corrections(const std::vector<DecodingGraphEdge::Id>& correction_ids, const std::vector<int>& correction_steps, const std::string& decoder) const;
     void log_results_entry(double logical_error_rate, int runs, double sum_sq, double p, double idling_time_constant, const std::string& decoder_name);
     void log_idling_entry(double p_idling, int runs, double p, double idling_time_constant, const std::string& decoder_name);
     void log_growth_steps(double p, const std::map<double, int>& frequencies, const std::string& decoder_name);
+    void log_latency_entry(double p, double mean_round_latency, double max_round_latency, double mean_finish_latency, int runs, const std::string& decoder_name);
+    void log_backlog(double p, const std::map<int, int>& frequencies, const std::string& decoder_name);
     void prepare_dump_dir() const;
 
     // Dump flag management
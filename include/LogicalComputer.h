@@ -4,49 +4,109 @@
 #include <memory>
 #include <vector>
 #include <unordered_map>
-#include <deque>
+#include <list>
 #include <cstdint>
 
 #include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
 
 struct DecodingResult;
 
 class LogicalComputer {
 public:
-    LogicalComputer(const std::shared_ptr<DecodingGraph>& graph);
+    // If a table with one entry per final syndrome fits into lookup_table_budget bytes, final readouts are
+    // resolved through it instead of running the union-find decoder. 0 disables the table.
+    LogicalComputer(const std::shared_ptr<DecodingGraph>& graph, size_t lookup_table_budget = DEFAULT_LOOKUP_TABLE_BUDGET);
 
-    // Clear cache when bulk errors / corrections change
+    static constexpr size_t DEFAULT_LOOKUP_TABLE_BUDGET = 64 << 20;
+
+    [[nodiscard]] bool uses_lookup_table() const { return use_lookup_table_; }
+
+    // Results are cached by the final syndrome left after all errors and corrections, so the cache stays valid
+    // across shots and decoders and never has to be cleared for correctness
     void clear_cache();
 
+    [[nodiscard]] size_t cache_hits() const { return cache_hits_; }
+
+    [[nodiscard]] size_t cache_misses() const { return cache_misses_; }
+
     int compute(
         const std::vector<std::shared_ptr<DecodingGraphEdge>>& bulk_errors,
         const std::vector<std::shared_ptr<DecodingGraphEdge>>& idling_errors,
         const DecodingResult& decoding_result
     );
 
+    // Samples `runs` single-round idling error realisations with error rate p_idling and returns how many of
+    // them lead to a logical error. Equivalent to calling compute() once per realisation, but the realisations
+    // are sampled and applied 64 at a time as bit-planes, and only realisations that change the final
+    // syndrome are decoded individually.
+    int compute_idling_failures(
+        const std::vector<std::shared_ptr<DecodingGraphEdge>>& bulk_errors,
+        const DecodingResult& decoding_result,
+        double p_idling,
+        const std::map<DecodingGraphEdge::Type, double>& noise_model,
+        int runs,
+        RandomStream& rng
+    );
+
 private:
-    int num_edges_;
+    int num_edges_; // largest edge id + 1
     int num_nodes_;
 
+    std::shared_ptr<DecodingGraph> graph_;
+
     // topology caches
     std::vector<std::vector<int>> node_edge_ids_;
     std::set<int> logical_edge_ids_;
 
     // parity buffer
     std::vector<uint8_t> final_measurement_;
+    // final_measurement_ of the bulk alone, which every idling realisation starts from
+    std::vector<uint8_t> bulk_measurement_;
+    std::vector<uint8_t> is_logical_edge_;
+
+    // bit-planes of a batch of idling realisations (bit k belongs to realisation k)
+    std::vector<uint64_t> idling_plane_;
+    std::vector<uint64_t> defect_plane_;
+
+    // Fills final_measurement_ with the bulk errors and corrections up to the considered round
+    void apply_bulk(
+        const std::vector<std::shared_ptr<DecodingGraphEdge>>& bulk_errors,
+        const DecodingResult& decoding_result);
+
+    // Returns the logical parity of final_measurement_ after the final classical decoding step
+    int evaluate_final_measurement();
+
+    // Logical parity of the final classical correction of syndrome_, taken from the lookup table or the cache
+    // if possible
+    int correction_parity();
+
+    // Runs the union-find decoder on syndrome_, returns the logical parity of its correction
+    int decode_syndrome();
+
+    // Lazily filled lookup table: final syndrome (one bit per single-layer node) -> decode_syndrome().
+    // Bit s of lookup_known_ tells whether bit s of lookup_parity_ has been computed yet.
+    bool use_lookup_table_ = false;
+    std::vector<uint64_t> lookup_known_;
+    std::vector<uint64_t> lookup_parity_;
 
-    // node lists
-    std::vector<std::shared_ptr<DecodingGraphNode>> nodes_;
-    std::vector<std::shared_ptr<DecodingGraphNode>> scratch_graph_nodes_;
+    std::shared_ptr<FlatDecodingGraph> scratch_graph_;
 
-    std::shared_ptr<DecodingGraph> scratch_graph_;
+    // ---------- syndrome cache ----------
+    // The final decode only depends on the final syndrome, so codes too large for the lookup table cache
+    // syndrome -> decode_syndrome() in a least recently used cache with exact key comparison
+    using Syndrome = std::vector<uint64_t>;
 
-    // ---------- idling cache ----------
-    uint64_t hash_idling(
-        const std::vector<std::shared_ptr<DecodingGraphEdge>>& idling_errors) const;
+    struct SyndromeHash {
+        size_t operator()(const Syndrome& syndrome) const;
+    };
 
-    std::unordered_map<uint64_t, int> cache_;
-    std::deque<uint64_t> cache_fifo_;
+    Syndrome syndrome_;
+    // most recently used entry first
+    std::list<std::pair<Syndrome, int>> cache_lru_;
+    std::unordered_map<Syndrome, std::list<std::pair<Syndrome, int>>::iterator, SyndromeHash> cache_;
+    size_t cache_hits_ = 0;
+    size_t cache_misses_ = 0;
 
     static constexpr size_t MAX_CACHE = 10000;
 };
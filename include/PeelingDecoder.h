@@ -6,18 +6,56 @@
 #define CLAYG_PEELINGDECODER_H
 
 
+#include <cstdint>
+
+#include "Cluster.h"
 #include "Decoder.h"
-#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+#include "WorkerPool.h"
 
+// Peels clusters along a breadth-first spanning tree. Every decoder owns one, its scratch space is indexed by
+// node and only grows with the graph, so peeling allocates nothing once it has seen the largest graph.
 class PeelingDecoder {
+    // Scratch space of one thread. A node has been visited by the current peel if its stamp equals `epoch`,
+    // so the scratch space never has to be cleared between calls. Distances are only valid for visited nodes.
+    struct Scratch
+    {
+        std::vector<uint32_t> visited;
+        std::vector<int> distance;
+        uint32_t epoch = 0;
+        std::vector<int> queue;
+        // (tree node, edge) pairs of the spanning tree in the order the edges were found
+        std::vector<std::pair<int, int>> spanning_tree;
+        // Corrections and peeling steps of the clusters a thread peeled concurrently
+        std::vector<int> corrections;
+        int steps = 0;
+    };
+    std::vector<Scratch> m_scratch = std::vector<Scratch>(1);
+    std::vector<const Cluster*> m_peeled;
+
+    // Fewer clusters per thread are not worth splitting
+    static constexpr int MIN_CLUSTERS_PER_THREAD = 8;
+
+    template <bool Concurrently>
+    static int peel(Scratch& scratch, const Cluster& cluster, FlatDecodingGraph& decoding_graph,
+                    std::vector<int>& corrections);
+
 public:
     PeelingDecoder() = default;
 
-    static DecodingResult decode(std::vector<std::shared_ptr<Cluster>>& clusters,
-                                                                  const std::shared_ptr<DecodingGraph>& decoding_graph);
+    // Peels the clusters with marked nodes in the order of their sequence numbers, see peel()
+    DecodingResult decode(const std::vector<std::shared_ptr<Cluster>>& clusters, FlatDecodingGraph& decoding_graph,
+                          WorkerPool* pool = nullptr);
+
+    // Peels `cluster`, appends its corrections to `corrections` and returns the depth of its spanning tree,
+    // i.e. the number of peeling steps
+    int peel(const Cluster& cluster, FlatDecodingGraph& decoding_graph, std::vector<int>& corrections);
 
-    static DecodingResult peel(const std::shared_ptr<Cluster>& cluster,
-                                                                const std::shared_ptr<DecodingGraph>& decoding_graph);
+    // Peels all of `clusters`, appends their corrections in cluster order and returns the most peeling steps
+    // any of them took. Clusters are disjoint, so with a pool, many clusters are split into one contiguous
+    // run per thread and peeled concurrently, with the same result as peeling them one after another.
+    int peel(const std::vector<const Cluster*>& clusters, FlatDecodingGraph& decoding_graph,
+             std::vector<int>& corrections, WorkerPool* pool = nullptr);
 };
 
 
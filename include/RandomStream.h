@@ -0,0 +1,59 @@
+#ifndef CLAYG_RANDOMSTREAM_H
+#define CLAYG_RANDOMSTREAM_H
+
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <string_view>
+
+// Counter-based random number stream (SplitMix64 output function applied to key + counter).
+// A stream is fully determined by a global seed and a list of keys, e.g. (p, shot, purpose), so any
+// stream can be reconstructed in isolation without replaying the streams that came before it.
+// Satisfies UniformRandomBitGenerator and can therefore be used with the <random> distributions.
+class RandomStream
+{
+    uint64_t m_key;
+    uint64_t m_counter = 0;
+
+    static constexpr uint64_t GAMMA = 0x9e3779b97f4a7c15ULL;
+
+    static constexpr uint64_t mix(uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+public:
+    using result_type = uint64_t;
+
+    // Purposes of the streams derived for a single shot
+    enum Purpose : uint64_t { BULK, IDLING };
+
+    RandomStream(const uint64_t seed, const std::initializer_list<uint64_t> keys) : m_key(mix(seed))
+    {
+        for (const uint64_t key : keys)
+            m_key = mix(m_key ^ mix(key + GAMMA));
+    }
+
+    // Key of a name (FNV-1a), the same on every platform and run unlike std::hash
+    static constexpr uint64_t key(const std::string_view name)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (const char c : name)
+            hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+        return hash;
+    }
+
+    static constexpr result_type min() { return 0; }
+
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() { return mix(m_key + ++m_counter * GAMMA); }
+
+    // Uniformly distributed double in [0, 1)
+    double uniform() { return static_cast<double>(operator()() >> 11) * 0x1.0p-53; }
+};
+
+
+#endif //CLAYG_RANDOMSTREAM_H
@@ -6,35 +6,202 @@
 #define CLAYG_UNIONFINDDECODER_H
 
 
-#include <functional>
-
+#include "ClusterPool.h"
 #include "DecodingGraph.h"
 #include "Decoder.h"
+#include "DisjointSetForest.h"
+#include "GrowthPolicy.h"
+#include "PeelingDecoder.h"
+#include "WorkerPool.h"
 
 class UnionFindDecoder : public Decoder
 {
+public:
+    // Boundary sizes seen by grow() over the lifetime of the decoder
+    struct BoundaryStats
+    {
+        long long grown_clusters = 0;
+        long long grown_edges = 0;
+        long long dropped_edges = 0;
+        int max_boundary = 0;
+    };
+
 protected:
     std::vector<std::shared_ptr<Cluster>> m_clusters;
-    std::function<float(DecodingGraphNode::Id, DecodingGraphNode::Id, DecodingGraphEdge::Type)> growth_policy_ =
-        [](DecodingGraphNode::Id start, DecodingGraphNode::Id end, DecodingGraphEdge::Type edge_type)
-        {
-            return 0.5;
-        };
+    ClusterPool cluster_pool_;
+    // Selected once at construction, grow() dispatches on it once per cluster
+    GrowthPolicy growth_policy_ = UniformGrowth{};
     bool stop_early_ = false;
+    BoundaryStats boundary_stats_;
+    PeelingDecoder peeling_decoder_;
+    // Weighted union-find: edges weigh log((1-p_e)/p_e) of the noise model, see set_noise()
+    bool weighted_ = false;
+    Growth normal_weight_ = GROWTH_UNITS;
+    Growth measurement_weight_ = GROWTH_UNITS;
+
+    void apply_edge_weights(FlatDecodingGraph& graph) const
+    {
+        graph.set_edge_weights(normal_weight_, measurement_weight_);
+    }
+
+    template <typename Policy>
+    std::vector<FlatDecodingGraph::FusionEdge> grow(FlatDecodingGraph& graph, Cluster& cluster, const Policy& policy);
+
+    // Threads that grow clusters concurrently (see grow_clusters()), 1 grows them on the calling thread
+    int grow_threads_ = 1;
+    std::shared_ptr<WorkerPool> grow_pool_;
+    // Whether every grow thread owns the edges of one spatial stripe of the layers instead of every n-th edge
+    bool stripes_ = false;
+    // Boundary edges each stripe has grown, see stripe_load()
+    std::vector<long long> stripe_load_;
+    // Steps of the whole graph with fewer non-neutral clusters per thread are not worth splitting. ClAYG splits
+    // its steps over the stripes regardless, see ClAYGDecoder::grow_and_merge().
+    static constexpr int MIN_CLUSTERS_PER_GROW_THREAD = 16;
+    // Merge steps with fewer fusion edges per stripe are not worth splitting
+    static constexpr int MIN_FUSION_EDGES_PER_STRIPE = 16;
+
+    // Growth of one cluster while clusters are grown concurrently
+    struct ClusterGrowth
+    {
+        std::vector<Cluster::BoundaryEdge> dropped;
+        // Growth the policy gives to each boundary edge, and whether the edge fused
+        std::vector<Growth> increments;
+        std::vector<uint8_t> fused;
+        // Indices into `dropped` and into the boundary, by edge shard
+        std::vector<std::vector<int>> shard_dropped;
+        std::vector<std::vector<int>> shard_boundary;
+    };
+    std::vector<ClusterGrowth> cluster_growth_;
+    std::vector<std::vector<int>> shard_grown_edges_;
+    std::vector<Cluster::BoundaryEdge> dropped_;
+    // Growth the policy gives to each boundary edge of the cluster grown serially, and the edges that fused
+    std::vector<Growth> increments_;
+    std::vector<uint64_t> fused_;
+    // Boundary entries of the cluster that fused, reported in the order of their ranks
+    std::vector<int> fused_entries_;
+
+    template <typename Policy>
+    std::vector<FlatDecodingGraph::FusionEdge> grow_concurrently(FlatDecodingGraph& graph,
+                                                                 const std::vector<Cluster*>& clusters,
+                                                                 const Policy& policy);
+
+    // Merge of one step on stripes (see merge_on_stripes()): the stripe of every cluster seen so far, or
+    // UNKNOWN_STRIPE, the stripe that merges each fusion edge, or -1 if it is merged afterwards, the fusion
+    // edges of each stripe, the nodes each stripe joined to a cluster and the cluster each fusion edge absorbed
+    static constexpr int UNKNOWN_STRIPE = -2;
+    std::vector<int> cluster_stripe_;
+    std::vector<int> fusion_edge_stripe_;
+    std::vector<std::vector<int>> stripe_fusion_edges_;
+    std::vector<std::vector<int>> stripe_joined_nodes_;
+    std::vector<Cluster*> absorbed_clusters_;
+    // The clusters and unclustered leaf nodes of a step, united as the fusion edges connect them, whether
+    // each set has been merged across stripes, and the set of every leaf node seen so far or -1
+    DisjointSetForest merge_units_;
+    std::vector<char> unit_crosses_stripes_;
+    std::vector<int> node_unit_;
+
+    // Merges the clusters at both ends of `fusion_edge` and returns the cluster that was absorbed, which the
+    // caller has to remove, or nullptr. Concurrently, the fusion edge has to lie within `stripe` together with
+    // both of its clusters, and nodes that join a cluster are collected in `joined_nodes`.
+    template <bool Concurrently>
+    Cluster* merge(FlatDecodingGraph& graph, const FlatDecodingGraph::FusionEdge& fusion_edge, int stripe,
+                   std::vector<int>& joined_nodes);
+
+    // Merges the fusion edges that lie within one stripe together with their clusters concurrently, every
+    // stripe in the order of `fusion_edges`, and the others afterwards in that order. A fusion edge within a
+    // stripe is merged afterwards as well if an earlier one has merged one of its clusters across stripes,
+    // so every merge sees the same clusters as when merging serially.
+    void merge_on_stripes(FlatDecodingGraph& graph, const std::vector<FlatDecodingGraph::FusionEdge>& fusion_edges);
+
+    // The two halves of merge_on_stripes(): the merges within the stripes, on the threads that own them, and
+    // the boundary exchange on the calling thread, which merges the fusion edges left across stripe borders
+    // and removes the absorbed clusters. The exchange has to follow the merges within the stripes of the same
+    // fusion edges.
+    void merge_within_stripes(FlatDecodingGraph& graph,
+                              const std::vector<FlatDecodingGraph::FusionEdge>& fusion_edges);
+    void exchange_stripe_borders(FlatDecodingGraph& graph,
+                                 const std::vector<FlatDecodingGraph::FusionEdge>& fusion_edges);
+
+    // Whether growth and merges can be split over stripes, see set_stripes()
+    [[nodiscard]] bool on_stripes(const FlatDecodingGraph& graph) const
+    {
+        return stripes_ && grow_pool_ && graph.has_row_bands(grow_threads_);
+    }
+
+    // Same as grow_clusters(), but always on the stripes, however few clusters there are to grow
+    std::vector<FlatDecodingGraph::FusionEdge> grow_on_stripes(FlatDecodingGraph& graph,
+                                                               const std::vector<std::shared_ptr<Cluster>>& clusters);
+
+    // Called whenever `cluster` has grown by a merge, possibly concurrently for clusters of different stripes
+    virtual void merged(Cluster&)
+    {
+    }
+
+    // Sequence number of the next cluster, see Cluster::sequence()
+    long long next_cluster_sequence_ = 0;
+
+    void add_cluster(const std::shared_ptr<Cluster>& cluster)
+    {
+        cluster->set_index(static_cast<int>(m_clusters.size()));
+        cluster->set_sequence(next_cluster_sequence_++);
+        m_clusters.push_back(cluster);
+    }
+
+    // Swap-removes `cluster` from m_clusters and returns it to the pool
+    void remove_cluster(const Cluster* cluster)
+    {
+        const int index = cluster->index();
+        m_clusters.back()->set_index(index);
+        std::swap(m_clusters[index], m_clusters.back());
+        cluster_pool_.release(std::move(m_clusters.back()));
+        m_clusters.pop_back();
+    }
 
 
 public:
     explicit UnionFindDecoder(const std::unordered_map<std::string, std::string>& args = {});
 
-    DecodingResult decode(std::shared_ptr<DecodingGraph> graph) override;
+    using Decoder::decode;
 
-    std::vector<DecodingGraphEdge::FusionEdge> grow(const std::shared_ptr<Cluster>& cluster);
+    DecodingResult decode(FlatDecodingGraph& graph) override;
 
-    virtual void merge(const std::vector<DecodingGraphEdge::FusionEdge>& fusion_edges);
+    std::vector<FlatDecodingGraph::FusionEdge> grow(FlatDecodingGraph& graph, const std::shared_ptr<Cluster>& cluster);
 
-    void set_growth_policy(const std::function<float(DecodingGraphNode::Id, DecodingGraphNode::Id, DecodingGraphEdge::Type)> policy) { growth_policy_ = policy; }
+    // Grows every non-neutral cluster of `clusters` once and returns the fusion edges in the order of the
+    // clusters' sequence numbers (see Cluster::sequence()) and of their boundary edges' ranks. With
+    // several grow threads, steps with many clusters are split over the threads; the growth of every edge
+    // is still added up in cluster order, so graph and fusion edges are the same as when growing serially.
+    std::vector<FlatDecodingGraph::FusionEdge> grow_clusters(FlatDecodingGraph& graph,
+                                                             const std::vector<std::shared_ptr<Cluster>>& clusters);
+
+    // Merges the clusters at both ends of every fusion edge. With stripes, steps with many fusion edges are
+    // split over the stripes, which gives the same clusters as merging serially.
+    void merge(FlatDecodingGraph& graph, const std::vector<FlatDecodingGraph::FusionEdge>& fusion_edges);
+
+    void set_growth_policy(const GrowthPolicy& policy) { growth_policy_ = policy; }
 
     void set_stop_early(const bool stop_early) { stop_early_ = stop_early; }
+
+    void set_grow_threads(int threads);
+
+    // Grows and merges on `stripes` threads, each of which owns the edges of one stripe of every layer (see
+    // FlatDecodingGraph::stripe()). Clusters that cross a stripe border are grown by the threads of all the
+    // stripes they touch and merged on the calling thread after the merges within the stripes, in the order
+    // of a serial merge, so the clusters and corrections stay the same. Graphs whose ancillas are not numbered in
+    // bands of rows (see FlatDecodingGraph::has_row_bands()) are grown and merged serially. Union-find only
+    // splits steps with many clusters or fusion edges, ClAYG every step of every round.
+    void set_stripes(int stripes);
+
+    void set_weighted(const bool weighted) { weighted_ = weighted; }
+
+    void set_noise(double p, const std::map<DecodingGraphEdge::Type, double>& noise_model) override;
+
+    [[nodiscard]] const BoundaryStats& boundary_stats() const { return boundary_stats_; }
+
+    [[nodiscard]] const ClusterPool::Stats& cluster_pool_stats() const { return cluster_pool_.stats(); }
+
+    // Boundary edges grown by each stripe in steps that were split over the threads, empty without stripes
+    [[nodiscard]] const std::vector<long long>& stripe_load() const { return stripe_load_; }
 };
 
 
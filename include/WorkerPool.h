@@ -0,0 +1,47 @@
+#ifndef CLAYG_WORKERPOOL_H
+#define CLAYG_WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that run batches of independent tasks. The threads are kept alive between batches,
+// so a batch only costs a wake-up, which makes the pool usable inside a single decoding step.
+class WorkerPool
+{
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const std::function<void(int)>* m_task = nullptr;
+    int m_task_count = 0;
+    std::atomic<int> m_next_task{0};
+    // Incremented for every batch, threads wait for it to change
+    int m_batch = 0;
+    int m_busy_threads = 0;
+    bool m_stop = false;
+
+    void work();
+
+    void run_tasks();
+
+public:
+    // `threads` includes the thread calling run(), which works on the batch as well
+    explicit WorkerPool(int threads);
+
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    [[nodiscard]] int threads() const { return static_cast<int>(m_threads.size()) + 1; }
+
+    // Runs task(0) ... task(count-1) and returns once all of them have finished
+    void run(int count, const std::function<void(int)>& task);
+};
+
+
+#endif //CLAYG_WORKERPOOL_H
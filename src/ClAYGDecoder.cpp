@@ -2,7 +2,11 @@
 // Created by tommasopeduzzi on 1/28/24.
 //
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <iostream>
+#include <limits>
 #include <utility>
 
 #include "ClAYGDecoder.h"
@@ -17,7 +21,10 @@ ClAYGDecoder::ClAYGDecoder(const std::unordered_map<std::string, std::string>& a
     this->decoder_name_.replace(0, 2, "clayg");
 
     if (auto it = args.find("cluster_lifetime"); it != args.end()) {
-        this->set_cluster_lifetime_factor(stod(it->second));
+        if (it->second == "adaptive")
+            this->set_adaptive_lifetime(true);
+        else
+            this->set_cluster_lifetime_factor(stod(it->second));
         this->decoder_name_ += "_lifetime_" + it->second;
     }
 
@@ -25,248 +32,436 @@ ClAYGDecoder::ClAYGDecoder(const std::unordered_map<std::string, std::string>& a
         this->set_growth_rounds(stoi(it->second));
         this->decoder_name_ += "_growth_rounds_" + it->second;
     }
-}
 
-DecodingResult ClAYGDecoder::decode(shared_ptr<DecodingGraph> graph)
-{
-    auto marked_nodes_by_round = graph->marked_nodes_by_round();
+    if (auto it = args.find("window"); it != args.end()) {
+        this->set_window(stoi(it->second));
+        this->decoder_name_ += "_window_" + it->second;
+    }
 
-    const int rounds = graph->t();
-    if (!decoding_graph_ || decoding_graph_->d() != graph->d())
-    {
-        decoding_graph_ = make_shared<DecodingGraph>(*graph);
+    // 0 means no limit
+    if (auto it = args.find("deadline_steps"); it != args.end()) {
+        this->set_deadline_steps(stoi(it->second));
+        this->decoder_name_ += "_deadline_steps_" + it->second;
     }
-    decoding_graph_->reset();
-    vector<shared_ptr<DecodingGraphEdge>> error_edges;
-    // Decoding step at which each correction in `error_edges` arrived (parallel vector).
-    vector<int> correction_steps;
-    auto append_corrections = [&](const vector<shared_ptr<DecodingGraphEdge>>& corrections, int arrived_at_step)
-    {
-        error_edges.insert(error_edges.end(), corrections.begin(), corrections.end());
-        correction_steps.insert(correction_steps.end(), corrections.size(), arrived_at_step);
-    };
 
-    m_clusters = {};
-    int step = 0;
-    int considered_up_to_round = rounds - 1;
-    int last_encountered_non_neutral_cluster = 0;
-    double growth_steps = -(rounds-1); // don't count last round as being negative
-    double max_growth_steps = growth_steps;
-    logger.log_decoding_step(m_clusters, decoder_name_, step++, rounds);
-    for (current_round_ = 0; current_round_ < rounds; current_round_++)
-    {
-        growth_steps = ceil(growth_steps);
-        for (const auto& node : marked_nodes_by_round[current_round_])
-        {
-            add(decoding_graph_, node);
-        }
-        auto peeling_results = clean(decoding_graph_);
-        // Corrections arrive at the step just logged, where the peeled clusters are gone.
-        int correction_step = step;
-        logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
-        append_corrections(peeling_results.corrections, correction_step);
-        // Growth after adding last round belongs to the bulk growth
-        double fixed_growth_steps = growth_steps_fixed(growth_steps,
-            peeling_results.decoding_steps/growth_rounds_);
-        max_growth_steps = max(max_growth_steps, fixed_growth_steps);
-        if (current_round_ == rounds-1)
-            break;
-        for (int growth_round = 0; growth_round < growth_rounds_; growth_round++)
-        {
-            vector<DecodingGraphEdge::FusionEdge> fusion_edges;
-            for (const auto& cluster : m_clusters)
-            {
-                if (cluster->is_neutral()) continue;
-                auto new_fusion_edges = grow(cluster);
-                for (const auto& fusion_edge : new_fusion_edges)
-                {
-                    fusion_edges.push_back(fusion_edge);
-                }
-            }
-            logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
-            merge(fusion_edges);
-            logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
-            growth_steps += (1.0/growth_rounds_);
-            if (stop_early_ && Cluster::all_clusters_are_neutral(m_clusters))
-            {
-                break;
-            }
-        }
-        logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
-        peeling_results = clean(decoding_graph_);
-        correction_step = step;
-        logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
-        append_corrections(peeling_results.corrections, correction_step);
-        fixed_growth_steps = growth_steps_fixed(growth_steps,
-            peeling_results.decoding_steps/growth_rounds_);
-        max_growth_steps = max(max_growth_steps, fixed_growth_steps);
+    if (auto it = args.find("deadline_ns"); it != args.end()) {
+        this->set_deadline_ns(stoll(it->second));
+        this->decoder_name_ += "_deadline_ns_" + it->second;
+    }
+}
 
-        if (stop_early_ && Cluster::all_clusters_are_neutral(m_clusters))
+DecodingResult ClAYGDecoder::decode(FlatDecodingGraph& graph)
+{
+    auto marked_nodes_by_round = graph.marked_nodes_by_round();
+
+    DecodingResult result;
+    bool ring_buffer = false;
+    auto append = [&](const DecodingResult& partial)
+    {
+        if (ring_buffer)
         {
-            int buffer_region = (decoding_graph_->d()+1)/2;
-            if (current_round_-last_encountered_non_neutral_cluster >= buffer_region)
+            // Edges of the ring buffer are recycled, map corrections onto `graph` while their rounds are held
+            for (const int edge : partial.correction_indices)
             {
-                considered_up_to_round = current_round_;
-                break;
+                result.correction_indices.push_back(graph.edge(decoding_graph_->edge_id(edge)));
             }
         }
         else
         {
-            last_encountered_non_neutral_cluster = current_round_;
+            result.correction_indices.insert(result.correction_indices.end(),
+                partial.correction_indices.begin(), partial.correction_indices.end());
         }
-    }
-
-    logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
+        result.correction_steps.insert(result.correction_steps.end(),
+            partial.correction_steps.begin(), partial.correction_steps.end());
+        result.round_latencies.push_back(partial.latency);
+        result.latency += partial.latency;
+    };
+    auto append_round = [&](const DecodingResult& partial)
+    {
+        append(partial);
+        if (has_deadline())
+            result.round_backlogs.push_back(partial.backlog);
+    };
 
-    while (!Cluster::all_clusters_are_neutral(m_clusters))
+    begin(graph);
+    ring_buffer = decoding_graph_->is_ring_buffer();
+    for (int round = 0; round < graph.t() && !stopped_; round++)
     {
-        growth_steps += 1;
-        vector<DecodingGraphEdge::FusionEdge> fusion_edges;
-        for (const auto& cluster : m_clusters)
+        vector<DecodingGraphNode::Id> defects;
+        for (const int node : marked_nodes_by_round[round])
         {
-            if (cluster->is_neutral()) continue;
-            auto new_fusion_edges = grow(cluster);
-            for (const auto& fusion_edge : new_fusion_edges)
-            {
-                fusion_edges.push_back(fusion_edge);
-            }
+            defects.push_back(graph.node_id(node));
         }
-        logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
-        merge(fusion_edges);
-        logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
+        append_round(push_round(defects));
     }
+    const auto final_result = finish();
+    append(final_result);
 
-    auto peeling_result = PeelingDecoder::decode(m_clusters, decoding_graph_);
-    max_growth_steps = max(max_growth_steps,growth_steps + peeling_result.decoding_steps);
-    // Final corrections arrive at the last step, where all clusters have been peeled away.
-    append_corrections(peeling_result.corrections, step);
-    logger.log_decoding_step({}, decoder_name_, step++, current_round_);
+    result.considered_up_to_round = final_result.considered_up_to_round;
+    result.decoding_steps = final_result.decoding_steps;
+    return result;
+}
+
+void ClAYGDecoder::begin(const FlatDecodingGraph& graph)
+{
+    begin_decoding(graph);
+}
+
+void ClAYGDecoder::begin(const string& code_name, const int d, const int t)
+{
+    begin_decoding(code_name, d, t);
+}
 
+DecodingResult ClAYGDecoder::push_round(const vector<DecodingGraphNode::Id>& defects)
+{
+    round_start_ = chrono::steady_clock::now();
     DecodingResult result;
-    result.corrections = error_edges;
-    result.considered_up_to_round = considered_up_to_round;
-    result.decoding_steps = max_growth_steps;
-    result.correction_steps = correction_steps;
+    if (!stopped_)
+    {
+        result = process_round(defects);
+        if (current_round_ == rounds_ - 1)
+            stopped_ = true;
+    }
+    result.considered_up_to_round = current_round_;
+    result.decoding_steps = max_growth_steps_;
+    result.backlog = growth_backlog_;
+    result.latency = chrono::duration<double>(chrono::steady_clock::now() - round_start_).count();
     return result;
 }
 
-void ClAYGDecoder::merge(const vector<DecodingGraphEdge::FusionEdge>& fusion_edges)
+DecodingResult ClAYGDecoder::finish()
 {
-    for (const auto& fusion_edge : fusion_edges)
-    {
-        auto tree_node = fusion_edge.tree_node;;
-        // assert that tree node has cluster
-        assert(tree_node->cluster().has_value());
-        auto leaf_node = fusion_edge.leaf_node;
+    const auto start = chrono::steady_clock::now();
+    auto result = finish_decoding();
+    stopped_ = true;
+    result.latency = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void ClAYGDecoder::reset_stream(const int rounds)
+{
+    cluster_pool_.release_all(m_clusters);
+    rounds_ = rounds;
+    step_ = 0;
+    current_round_ = -1;
+    considered_up_to_round_ = rounds - 1;
+    last_encountered_non_neutral_cluster_ = 0;
+    window_flushes_ = 0;
+    growth_backlog_ = 0;
+    growth_steps_ = -(rounds-1); // don't count last round as being negative
+    max_growth_steps_ = growth_steps_;
+    stopped_ = rounds <= 0;
+}
 
-        auto cluster = tree_node->cluster().value().lock();
-        auto other_cluster_optional = leaf_node->cluster();
+void ClAYGDecoder::begin_decoding(const FlatDecodingGraph& graph)
+{
+    if (window_ > 0)
+    {
+        begin_decoding(graph.code_name(), graph.d(), graph.t());
+        return;
+    }
+    if (!decoding_graph_ || !decoding_graph_->shares_topology(graph))
+    {
+        // Own state on the topology of `graph`, node and edge indices are the same as in `graph`
+        decoding_graph_ = FlatDecodingGraph::overlay(graph);
+    }
+    start_decoding(graph.t());
+}
 
-        if (!other_cluster_optional.has_value())
+void ClAYGDecoder::begin_decoding(const string& code_name, const int d, const int t)
+{
+    if (window_ > 0)
+    {
+        if (!decoding_graph_ || decoding_graph_->d() != d || decoding_graph_->code_name() != code_name)
         {
-            // node is not part of another cluster
-            cluster->add_node(leaf_node);
-            if (leaf_node->marked())
-                cluster->add_marked_node(leaf_node);
-            if (leaf_node->id().type == DecodingGraphNode::VIRTUAL)
-                cluster->add_virtual_node(leaf_node);
-
-            cluster->add_bulk_edge(fusion_edge.edge);
-            for (const auto& edge_weak_ptr : leaf_node->edges())
-            {
-                auto edge = edge_weak_ptr.lock();
-                if (edge != fusion_edge.edge)
-                {
-                    cluster->add_boundary_edge(Cluster::BoundaryEdge{
-                        leaf_node,
-                        edge->other_node(leaf_node).lock(),
-                        edge
-                    });
-                }
-            }
-            leaf_node->set_cluster(cluster);
-            if (cluster->is_neutral())
-                cluster->set_has_been_neutral_since(current_round_);
-            continue;
+            decoding_graph_ = FlatDecodingGraph::ring_buffer(code_name, d, window_);
         }
+    }
+    else if (!decoding_graph_ || decoding_graph_->d() != d || decoding_graph_->t() != t
+        || decoding_graph_->code_name() != code_name)
+    {
+        decoding_graph_ = FlatDecodingGraph::overlay(code_name, d, t);
+    }
+    start_decoding(t);
+}
 
-        auto other_cluster = other_cluster_optional.value().lock();
+void ClAYGDecoder::start_decoding(const int t)
+{
+    decoding_graph_->reset();
+    apply_edge_weights(*decoding_graph_);
+    if (decoding_graph_->is_ring_buffer())
+    {
+        decoding_graph_->start_stream(t);
+    }
+    reset_stream(t);
+    logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, rounds_);
+}
 
-        if (other_cluster == cluster)
-        {
-            continue;
-        }
+DecodingResult ClAYGDecoder::process_round(const vector<DecodingGraphNode::Id>& defects)
+{
+    DecodingResult result;
+    auto append_corrections = [&](const vector<int>& corrections, int arrived_at_step)
+    {
+        result.correction_indices.insert(result.correction_indices.end(), corrections.begin(), corrections.end());
+        result.correction_steps.insert(result.correction_steps.end(), corrections.size(), arrived_at_step);
+    };
 
-        for (const auto& node : other_cluster->nodes())
+    current_round_++;
+    growth_steps_ = ceil(growth_steps_);
+    if (decoding_graph_->recycling_blocked(current_round_))
+    {
+        append_corrections(flush_window().correction_indices, step_);
+        logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, current_round_);
+    }
+    decoding_graph_->advance(current_round_);
+    for (const auto& id : defects)
+    {
+        add(*decoding_graph_, id);
+    }
+    auto peeling_results = clean(*decoding_graph_);
+    // Corrections arrive at the step just logged, where the peeled clusters are gone.
+    int correction_step = step_;
+    logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, current_round_);
+    append_corrections(peeling_results.correction_indices, correction_step);
+    // Growth after adding last round belongs to the bulk growth
+    double fixed_growth_steps = growth_steps_fixed(growth_steps_,
+        peeling_results.decoding_steps/growth_rounds_);
+    max_growth_steps_ = max(max_growth_steps_, fixed_growth_steps);
+    if (current_round_ == rounds_-1)
+        return result;
+    grow_within_deadline();
+    logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, current_round_);
+    peeling_results = clean(*decoding_graph_);
+    correction_step = step_;
+    logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, current_round_);
+    append_corrections(peeling_results.correction_indices, correction_step);
+    fixed_growth_steps = growth_steps_fixed(growth_steps_,
+        peeling_results.decoding_steps/growth_rounds_);
+    max_growth_steps_ = max(max_growth_steps_, fixed_growth_steps);
+
+    if (stop_early_ && Cluster::all_clusters_are_neutral(m_clusters))
+    {
+        int buffer_region = (decoding_graph_->d()+1)/2;
+        if (current_round_-last_encountered_non_neutral_cluster_ >= buffer_region)
         {
-            cluster->add_node(node);
-            if (node->id().type == DecodingGraphNode::VIRTUAL)
-            {
-                cluster->add_virtual_node(node);
-            }
-            if (node->marked())
-            {
-                cluster->add_marked_node(node);
-            }
-            node->set_cluster(cluster);
+            considered_up_to_round_ = current_round_;
+            stopped_ = true;
         }
-        for (const auto& edge : other_cluster->edges())
+    }
+    else
+    {
+        last_encountered_non_neutral_cluster_ = current_round_;
+    }
+    return result;
+}
+
+DecodingResult ClAYGDecoder::finish_decoding()
+{
+    logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, current_round_);
+    return grow_until_neutral_and_peel();
+}
+
+void ClAYGDecoder::grow_and_merge()
+{
+    if (on_stripes(*decoding_graph_))
+    {
+        // A round only grows a few clusters, far from enough to split a step of union-find, so ClAYG splits
+        // every step: each thread grows the boundary edges its stripes own and merges the fusion edges within
+        // them, then the boundary exchange merges the clusters that met across a stripe border
+        auto fusion_edges = grow_on_stripes(*decoding_graph_, m_clusters);
+        logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, current_round_);
+        if (!fusion_edges.empty())
         {
-            cluster->add_bulk_edge(edge);
+            merge_within_stripes(*decoding_graph_, fusion_edges);
+            exchange_stripe_borders(*decoding_graph_, fusion_edges);
         }
-        for (const auto& boundary : other_cluster->boundary())
+        logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, current_round_);
+        return;
+    }
+    auto fusion_edges = grow_clusters(*decoding_graph_, m_clusters);
+    logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, current_round_);
+    merge(*decoding_graph_, fusion_edges);
+    logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, current_round_);
+}
+
+bool ClAYGDecoder::deadline_reached(const int steps) const
+{
+    if (deadline_steps_ > 0 && steps >= deadline_steps_)
+        return true;
+    return deadline_ns_ > 0 && chrono::steady_clock::now() - round_start_ >= chrono::nanoseconds(deadline_ns_);
+}
+
+void ClAYGDecoder::grow_within_deadline()
+{
+    const int owed = growth_backlog_ + growth_rounds_;
+    int grown = 0;
+    for (; grown < owed && !deadline_reached(grown); grown++)
+    {
+        grow_and_merge();
+        growth_steps_ += 1.0/growth_rounds_;
+        if (stop_early_ && Cluster::all_clusters_are_neutral(m_clusters))
         {
-            cluster->add_boundary_edge(boundary);
+            break;
         }
+    }
+    // Growth that did not fit into this round is owed by the next one, unless there is nothing left to grow
+    growth_backlog_ = grown < owed && !Cluster::all_clusters_are_neutral(m_clusters) ? owed - grown : 0;
+}
 
-        if (cluster->is_neutral())
-            cluster->set_has_been_neutral_since(current_round_);
+DecodingResult ClAYGDecoder::grow_until_neutral_and_peel()
+{
+    while (!Cluster::all_clusters_are_neutral(m_clusters))
+    {
+        growth_steps_ += 1;
+        grow_and_merge();
+    }
+
+    auto peeling_result = peeling_decoder_.decode(m_clusters, *decoding_graph_, grow_pool_.get());
+    max_growth_steps_ = max(max_growth_steps_, growth_steps_ + peeling_result.decoding_steps);
+    // Final corrections arrive at the last step, where all clusters have been peeled away.
+    DecodingResult result;
+    result.correction_indices = peeling_result.correction_indices;
+    result.correction_steps.assign(result.correction_indices.size(), step_);
+    logger.log_decoding_step(*decoding_graph_, {}, decoder_name_, step_++, current_round_);
+    result.considered_up_to_round = considered_up_to_round_;
+    result.decoding_steps = max_growth_steps_;
+    return result;
+}
 
-        auto cluster_to_be_removed = find(m_clusters.begin(), m_clusters.end(), other_cluster);
-        if (cluster_to_be_removed != m_clusters.end())
-            m_clusters.erase(cluster_to_be_removed);
+DecodingResult ClAYGDecoder::flush_window()
+{
+    window_flushes_++;
+    while (!Cluster::all_clusters_are_neutral(m_clusters))
+    {
+        growth_steps_ += 1;
+        grow_and_merge();
     }
+    // The deadline does not apply, the round can not be recycled before the clusters are gone
+    growth_backlog_ = 0;
+    auto result = clean(*decoding_graph_, false);
+    max_growth_steps_ = max(max_growth_steps_, growth_steps_ + result.decoding_steps);
+    return result;
+}
+
+void ClAYGDecoder::merged(Cluster& cluster)
+{
+    if (cluster.is_neutral())
+        cluster.set_has_been_neutral_since(current_round_);
 }
 
-void ClAYGDecoder::add(const shared_ptr<DecodingGraph>& graph, shared_ptr<DecodingGraphNode> node)
+void ClAYGDecoder::add(FlatDecodingGraph& graph, const DecodingGraphNode::Id id)
 {
     // Find corresponding node in the flattened decoding graph
-    auto id = node->id();
-    node = graph->node(id).value();
-    node->set_marked(!node->marked());
-    if (node->cluster().has_value())
+    const int node = graph.node(id);
+    graph.set_marked(node, !graph.marked(node));
+    if (Cluster* cluster = graph.cluster(node))
     {
-        auto cluster = node->cluster().value().lock();
-        if (node->marked())
+        if (graph.marked(node))
         {
-            cluster->add_marked_node(node);
+            cluster->add_marked_node();
         }
         else
         {
-            cluster->remove_marked_node(node);
+            cluster->remove_marked_node();
         }
     }
     else
     {
-        auto new_cluster = make_shared<Cluster>(node);
-        node->set_cluster(new_cluster);
-        if (node->marked())
+        auto new_cluster = cluster_pool_.acquire(node, graph);
+        graph.add_cluster(node, new_cluster.get());
+        if (graph.marked(node))
         {
-            new_cluster->add_marked_node(node);
+            new_cluster->add_marked_node();
         }
-        if (node->id().type == DecodingGraphNode::VIRTUAL)
+        if (graph.is_virtual(node))
         {
             new_cluster->add_virtual_node(node);
         }
-        m_clusters.push_back(new_cluster);
+        add_cluster(new_cluster);
+    }
+}
+
+long long ClAYGDecoder::reach(const FlatDecodingGraph& decoding_graph) const
+{
+    // Slowest growth along a normal edge and fastest growth along a measurement edge in either direction
+    const auto [normal, measurement] = visit([](const auto& policy)
+    {
+        const DecodingGraphNode::Id earlier{DecodingGraphNode::ANCILLA, 0, 0};
+        const DecodingGraphNode::Id later{DecodingGraphNode::ANCILLA, 1, 0};
+        return pair{policy(earlier, earlier, DecodingGraphEdge::NORMAL),
+                    max(policy(later, earlier, DecodingGraphEdge::MEASUREMENT),
+                        policy(earlier, later, DecodingGraphEdge::MEASUREMENT))};
+    }, growth_policy_);
+    if (normal <= 0)
+        return numeric_limits<long long>::max();
+    // A non-neutral cluster stops growing once it reaches the boundary, at most about d/2 normal edges away. In
+    // the steps that takes it grows across as many more measurement edges as the policy and the edge weights
+    // allow. Clusters also grow growth_rounds_ steps per round, the reach is scaled by that too to err on the
+    // side of keeping clusters.
+    const long long boundary_distance = static_cast<long long>((decoding_graph.d() + 1) / 2) * normal_weight_;
+    const long long rounds = (boundary_distance * measurement + static_cast<long long>(normal) * measurement_weight_
+        - 1) / (static_cast<long long>(normal) * measurement_weight_);
+    return rounds * growth_rounds_;
+}
+
+void ClAYGDecoder::find_reachable_clusters(const FlatDecodingGraph& decoding_graph)
+{
+    // A non-neutral cluster can not grow into a neutral cluster that is further than reach() rounds from it. Once
+    // it has grown into one it also spans the rounds of that cluster and reaches on from there, so a cluster is
+    // reachable if a chain of clusters, each within reach() rounds of the next, leads to it from a non-neutral
+    // cluster or from the rounds still to come. The virtual nodes are shared by all rounds, a cluster that grows
+    // into one after its neutral cluster was peeled is neutral all the same, only peeled along another tree.
+    const long long reach = this->reach(decoding_graph);
+    cluster_rounds_.clear();
+    for (int i = 0; i < static_cast<int>(m_clusters.size()); i++)
+    {
+        // Clusters without ancillas span no rounds, they hold a virtual node and are neutral and out of reach
+        if (m_clusters[i]->first_round() <= m_clusters[i]->last_round())
+            cluster_rounds_.emplace_back(m_clusters[i]->first_round(), m_clusters[i]->last_round(), i);
+    }
+    // The defects of the rounds still to come start new clusters
+    cluster_rounds_.emplace_back(current_round_ + 1, numeric_limits<int>::max(), -1);
+    ranges::sort(cluster_rounds_);
+
+    // In order of their first round, a cluster continues the chain before it if it starts within reach() rounds
+    // of the last round the chain spans
+    reachable_.assign(m_clusters.size(), 0);
+    size_t chain_start = 0;
+    int chain_last_round = 0;
+    bool chain_is_reachable = false;
+    auto end_chain = [&](const size_t chain_end)
+    {
+        for (size_t k = chain_start; chain_is_reachable && k < chain_end; k++)
+        {
+            if (const int i = get<2>(cluster_rounds_[k]); i >= 0)
+                reachable_[i] = 1;
+        }
+    };
+    for (size_t k = 0; k < cluster_rounds_.size(); k++)
+    {
+        const auto [first_round, last_round, i] = cluster_rounds_[k];
+        if (k == 0 || first_round - chain_last_round > reach)
+        {
+            end_chain(k);
+            chain_start = k;
+            chain_last_round = last_round;
+            chain_is_reachable = false;
+        }
+        chain_last_round = max(chain_last_round, last_round);
+        chain_is_reachable |= i < 0 || !m_clusters[i]->is_neutral();
     }
+    end_chain(cluster_rounds_.size());
 }
 
-DecodingResult ClAYGDecoder::clean(const shared_ptr<DecodingGraph>& decoding_graph)
+DecodingResult ClAYGDecoder::clean(FlatDecodingGraph& decoding_graph, const bool keep_young_clusters)
 {
-    vector<shared_ptr<DecodingGraphEdge>> error_edges;
-    double peeling_steps = 0;
+    vector<int> error_edges;
     vector<shared_ptr<Cluster>> new_clusters;
+    retired_clusters_.clear();
+    if (adaptive_lifetime_ && keep_young_clusters)
+    {
+        find_reachable_clusters(decoding_graph);
+    }
     for (auto& cluster : m_clusters)
     {
         // Keep non-neutral-clusters around
@@ -277,186 +472,192 @@ DecodingResult ClAYGDecoder::clean(const shared_ptr<DecodingGraph>& decoding_gra
         }
 
         // Keep newly neutral clusters around.
-        int cluster_lifetime = 0;
-        if (cluster_lifetime_factor_ < 1)
+        bool keep = false;
+        if (adaptive_lifetime_)
         {
-            cluster_lifetime = decoding_graph->d() * cluster_lifetime_factor_;
+            keep = reachable_[cluster->index()];
         }
-        else {
-            cluster_lifetime = static_cast<int>(cluster_lifetime_factor_);
+        else
+        {
+            int cluster_lifetime = 0;
+            if (cluster_lifetime_factor_ < 1)
+            {
+                cluster_lifetime = decoding_graph.d() * cluster_lifetime_factor_;
+            }
+            else {
+                cluster_lifetime = static_cast<int>(cluster_lifetime_factor_);
+            }
+            keep = current_round_ - cluster->has_been_neutral_since() < cluster_lifetime;
         }
 
-        if (current_round_ - cluster->has_been_neutral_since() < cluster_lifetime)
+        if (keep_young_clusters && keep)
         {
             new_clusters.push_back(move(cluster));
             continue;
         }
 
-        // Peel older, neutral clusters.
-        auto cluster_peel_results = PeelingDecoder::peel(cluster, decoding_graph);
-        auto new_error_edges = cluster_peel_results.corrections;
-        peeling_steps = max(peeling_steps, cluster_peel_results.decoding_steps);
-        error_edges.insert(error_edges.end(), new_error_edges.begin(), new_error_edges.end());
+        retired_clusters_.push_back(cluster.get());
+    }
 
-        for (const auto& node : cluster->nodes())
+    // Peel older, neutral clusters. Dissolving a cluster does not change how the others are peeled, so all of
+    // them are peeled first, concurrently if there are many, in the order of their sequence numbers.
+    ranges::sort(retired_clusters_, {}, &Cluster::sequence);
+    const double peeling_steps = peeling_decoder_.peel(retired_clusters_, decoding_graph, error_edges,
+                                                       grow_pool_.get());
+    for (const Cluster* cluster : retired_clusters_)
+    {
+        for (const int node : cluster->nodes())
         {
-            node->set_cluster(nullopt);
+            decoding_graph.remove_from_cluster(node);
         }
-        for (const auto& edge : cluster->edges())
+        // The boundary still holds the edges that nodes joined through, so its growth is taken back before the
+        // bulk edges are reset, which leaves them at zero rather than below it
+        const auto& boundary = cluster->boundary();
+        for (int i = 0; i < boundary.size(); i++)
         {
-            edge->reset_growth();
+            decoding_graph.add_growth(boundary.edges[i], static_cast<Growth>(-boundary.growth_from_tree[i]));
         }
-
-        for (const auto& boundary_edge : cluster->boundary())
+        for (const int edge : cluster->edges())
         {
-            boundary_edge.edge->add_growth(-boundary_edge.growth_from_tree);
+            decoding_graph.reset_growth(edge);
+            decoding_graph.remove_bulk_edge(edge);
+        }
+    }
+    // The clusters that were kept have been moved out, what is left was dissolved
+    for (auto& cluster : m_clusters)
+    {
+        if (cluster)
+        {
+            cluster_pool_.release(move(cluster));
         }
     }
     m_clusters = move(new_clusters);
-    return {error_edges, 0,peeling_steps};
+    for (int i = 0; i < static_cast<int>(m_clusters.size()); i++)
+    {
+        m_clusters[i]->set_index(i);
+    }
+    DecodingResult result;
+    result.correction_indices = error_edges;
+    result.considered_up_to_round = 0;
+    result.decoding_steps = peeling_steps;
+    return result;
 }
 
 SingleLayerClAYGDecoder::SingleLayerClAYGDecoder(const std::unordered_map<std::string, std::string>& args)
         : ClAYGDecoder(args)
 {
     decoder_name_ = "sl_" + decoder_name_;
+    // The single layer is recycled every round already
+    if (window_ > 0) {
+        cerr << "Invalid argument for " << decoder_name_ << ": window=" << window_ << "\n"
+             << "Reason: the single layer is recycled every round, it has no window of rounds" << endl;
+        exit(1);
+    }
+    // All nodes of the single layer are in round 0, so there is no distance in rounds to measure
+    if (adaptive_lifetime_) {
+        cerr << "Invalid argument for " << decoder_name_ << ": cluster_lifetime=adaptive\n"
+             << "Reason: the single layer has no rounds to measure the distance between clusters in" << endl;
+        exit(1);
+    }
+}
+
+DecodingResult SingleLayerClAYGDecoder::decode(FlatDecodingGraph& graph)
+{
+    auto result = ClAYGDecoder::decode(graph);
+    // Corrections live on the single layer, map them back onto the edges of `graph`
+    for (int& edge : result.correction_indices)
+    {
+        edge = graph.edge(decoding_graph_->edge_id(edge));
+    }
+    return result;
 }
 
-DecodingResult SingleLayerClAYGDecoder::decode(shared_ptr<DecodingGraph> graph)
+void SingleLayerClAYGDecoder::begin_decoding(const FlatDecodingGraph& graph)
 {
-    auto marked_nodes_by_round = graph->marked_nodes_by_round();
+    begin_decoding(graph.code_name(), graph.d(), graph.t());
+}
 
-    const int rounds = graph->t();
-    if (!decoding_graph_ || decoding_graph_->d() != graph->d())
+void SingleLayerClAYGDecoder::begin_decoding(const string& code_name, const int d, const int t)
+{
+    if (!decoding_graph_ || decoding_graph_->code_name() != code_name || decoding_graph_->d() != d)
     {
-        decoding_graph_ = DecodingGraph::single_layer_copy(graph);
+        decoding_graph_ = FlatDecodingGraph::overlay(code_name, d, 1);
     }
     else
     {
         decoding_graph_->reset(); // Reset the graph to its initial state
     }
+    apply_edge_weights(*decoding_graph_);
+    reset_stream(t);
+}
 
-    vector<shared_ptr<DecodingGraphEdge>> error_edges;
-    // Decoding step at which each correction in `error_edges` arrived (parallel vector).
-    vector<int> correction_steps;
-    auto append_corrections = [&](const vector<shared_ptr<DecodingGraphEdge>>& corrections, int arrived_at_step)
+DecodingResult SingleLayerClAYGDecoder::process_round(const vector<DecodingGraphNode::Id>& defects)
+{
+    DecodingResult result;
+    auto append_corrections = [&](const vector<int>& corrections, int arrived_at_step)
     {
-        error_edges.insert(error_edges.end(), corrections.begin(), corrections.end());
-        correction_steps.insert(correction_steps.end(), corrections.size(), arrived_at_step);
+        result.correction_indices.insert(result.correction_indices.end(), corrections.begin(), corrections.end());
+        result.correction_steps.insert(result.correction_steps.end(), corrections.size(), arrived_at_step);
     };
 
-    m_clusters = {};
-    int step = 0;
-    int considered_up_to_round = rounds - 1;
-    int last_encountered_non_neutral_cluster = 0;
-    double growth_steps = -(rounds-1);
-    double max_growth_steps = growth_steps;
-    for (current_round_ = 0; current_round_ < rounds; current_round_++)
+    current_round_++;
+    growth_steps_ = ceil(growth_steps_);
+    for (const auto& id : defects)
     {
-        growth_steps = ceil(growth_steps);
-        for (const auto& node : marked_nodes_by_round[current_round_])
-        {
-            add(decoding_graph_, node);
-        }
-        auto result = clean(decoding_graph_);
-        max_growth_steps = max(max_growth_steps, growth_steps + result.decoding_steps);
-        // Corrections arrive at the step just logged, where the peeled clusters are gone.
-        int correction_step = step;
-        logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
-        append_corrections(result.corrections, correction_step);
-        // Growth after adding last round belongs to the bulk growth
-        if (current_round_ == rounds-1)
-            break;
-        for (int growth_round = 0; growth_round < growth_rounds_; growth_round++)
-        {
-            vector<DecodingGraphEdge::FusionEdge> fusion_edges;
-            for (const auto& cluster : m_clusters)
-            {
-                if (cluster->is_neutral()) continue;
-                auto new_fusion_edges = grow(cluster);
-                for (const auto& fusion_edge : new_fusion_edges)
-                {
-                    fusion_edges.push_back(fusion_edge);
-                }
-            }
-            logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
-            merge(fusion_edges);
-            logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
-            growth_steps += 1.0/growth_rounds_;
-            if (stop_early_ && Cluster::all_clusters_are_neutral(m_clusters))
-            {
-                break;
-            }
-        }
-        auto peeling_results = clean(decoding_graph_);
-        double fixed_growth_steps = growth_steps_fixed(growth_steps,
-            peeling_results.decoding_steps/growth_rounds_);
-        max_growth_steps = max(max_growth_steps,  fixed_growth_steps);
-        correction_step = step;
-        logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
-        append_corrections(peeling_results.corrections, correction_step);
-        if (stop_early_ && Cluster::all_clusters_are_neutral(m_clusters))
-        {
-            if (current_round_-last_encountered_non_neutral_cluster >= (decoding_graph_->d()-1)/2)
-            {
-                considered_up_to_round = current_round_;
-                break;
-            }
-        }
-        else
-        {
-            last_encountered_non_neutral_cluster = current_round_;
-        }
+        add(*decoding_graph_, id);
     }
-
-    while (!Cluster::all_clusters_are_neutral(m_clusters))
+    auto clean_result = clean(*decoding_graph_);
+    max_growth_steps_ = max(max_growth_steps_, growth_steps_ + clean_result.decoding_steps);
+    // Corrections arrive at the step just logged, where the peeled clusters are gone.
+    int correction_step = step_;
+    logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, current_round_);
+    append_corrections(clean_result.correction_indices, correction_step);
+    // Growth after adding last round belongs to the bulk growth
+    if (current_round_ == rounds_-1)
+        return result;
+    grow_within_deadline();
+    auto peeling_results = clean(*decoding_graph_);
+    double fixed_growth_steps = growth_steps_fixed(growth_steps_,
+        peeling_results.decoding_steps/growth_rounds_);
+    max_growth_steps_ = max(max_growth_steps_,  fixed_growth_steps);
+    correction_step = step_;
+    logger.log_decoding_step(*decoding_graph_, m_clusters, decoder_name_, step_++, current_round_);
+    append_corrections(peeling_results.correction_indices, correction_step);
+    if (stop_early_ && Cluster::all_clusters_are_neutral(m_clusters))
     {
-        growth_steps += 1;
-        vector<DecodingGraphEdge::FusionEdge> fusion_edges;
-        for (const auto& cluster : m_clusters)
+        if (current_round_-last_encountered_non_neutral_cluster_ >= (decoding_graph_->d()-1)/2)
         {
-            if (cluster->is_neutral()) continue;
-            auto new_fusion_edges = grow(cluster);
-            for (const auto& fusion_edge : new_fusion_edges)
-            {
-                fusion_edges.push_back(fusion_edge);
-            }
+            considered_up_to_round_ = current_round_;
+            stopped_ = true;
         }
-        logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
-        merge(fusion_edges);
-        logger.log_decoding_step(m_clusters, decoder_name_, step++, current_round_);
     }
-
-    auto [peeling_error_edges, _, steps, peeling_correction_steps] = PeelingDecoder::decode(m_clusters, decoding_graph_);
-    max_growth_steps = max(max_growth_steps, growth_steps + steps);
-    // Final corrections arrive at the last step, where all clusters have been peeled away.
-    append_corrections(peeling_error_edges, step);
-    logger.log_decoding_step({}, decoder_name_, step++, current_round_);
-    DecodingResult result;
-    result.corrections = error_edges;
-    result.considered_up_to_round = considered_up_to_round;
-    result.decoding_steps = max_growth_steps;
-    result.correction_steps = correction_steps;
+    else
+    {
+        last_encountered_non_neutral_cluster_ = current_round_;
+    }
     return result;
 }
 
-void SingleLayerClAYGDecoder::add(const shared_ptr<DecodingGraph>& graph, shared_ptr<DecodingGraphNode> node)
+DecodingResult SingleLayerClAYGDecoder::finish_decoding()
+{
+    return grow_until_neutral_and_peel();
+}
+
+void SingleLayerClAYGDecoder::add(FlatDecodingGraph& graph, DecodingGraphNode::Id id)
 {
     // Find corresponding node in the flattened decoding graph
-    auto id = node->id();
     id.round = 0;
-    node = graph->node(id).value();
-    node->set_marked(!node->marked());
-    if (node->cluster().has_value())
+    const int node = graph.node(id);
+    graph.set_marked(node, !graph.marked(node));
+    if (Cluster* cluster = graph.cluster(node))
     {
-        auto cluster = node->cluster().value().lock();
-        if (node->marked())
+        if (graph.marked(node))
         {
-            cluster->add_marked_node(node);
+            cluster->add_marked_node();
         }
         else
         {
-            cluster->remove_marked_node(node);
+            cluster->remove_marked_node();
         }
         if (cluster->is_neutral())
         {
@@ -465,16 +666,16 @@ void SingleLayerClAYGDecoder::add(const shared_ptr<DecodingGraph>& graph, shared
     }
     else
     {
-        auto new_cluster = make_shared<Cluster>(node);
-        node->set_cluster(new_cluster);
-        if (node->marked())
+        auto new_cluster = cluster_pool_.acquire(node, graph);
+        graph.add_cluster(node, new_cluster.get());
+        if (graph.marked(node))
         {
-            new_cluster->add_marked_node(node);
+            new_cluster->add_marked_node();
         }
-        if (node->id().type == DecodingGraphNode::VIRTUAL)
+        if (graph.is_virtual(node))
         {
             new_cluster->add_virtual_node(node);
         }
-        m_clusters.push_back(new_cluster);
+        add_cluster(new_cluster);
     }
 }
@@ -2,43 +2,129 @@
 // Created by tommasopeduzzi on 1/12/24.
 //
 
+#include <limits>
 #include <memory>
 
 #include "Cluster.h"
-#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
 
 using namespace std;
 
-Cluster::Cluster(shared_ptr<DecodingGraphNode> root)
+Cluster::Cluster(const int root, const FlatDecodingGraph& graph)
+{
+    reset(root, graph);
+}
+
+void Cluster::reset(const int root, const FlatDecodingGraph& graph)
 {
     m_root = root;
+    m_peel_start = root;
+    m_nodes.clear();
+    m_bulk_edges.clear();
+    m_boundary.tree_nodes.clear();
+    m_boundary.leaf_nodes.clear();
+    m_boundary.edges.clear();
+    m_boundary.growth_from_tree.clear();
+    m_boundary.ranks.clear();
+    m_first_rank = m_next_rank = 0;
+    m_marked_count = 0;
+    m_virtual_count = 0;
+    m_index = -1;
+    m_has_been_neutral_since = -1;
+
     m_nodes.push_back(root);
-    if (root->id().type == DecodingGraphNode::VIRTUAL)
+    if (graph.is_virtual(root))
+    {
+        m_virtual_count++;
+        m_first_round = numeric_limits<int>::max();
+        m_last_round = numeric_limits<int>::min();
+    }
+    else
     {
-        m_virtual_nodes.push_back(root);
+        m_first_round = m_last_round = graph.node_id(root).round;
     }
-    m_marked_nodes = {};
-    m_boundary = {};
-    for (const auto& edge_weak_ptr : root->edges())
+    const auto edges = graph.incident_edges(root);
+    const auto neighbors = graph.neighbors(root);
+    m_boundary.reserve(static_cast<int>(edges.size()));
+    for (size_t i = 0; i < edges.size(); i++)
     {
         m_boundary.push_back({
             root,
-            edge_weak_ptr.lock()->other_node(root).lock(),
-            edge_weak_ptr.lock()
-        });
+            neighbors[i],
+            edges[i]
+        }, m_next_rank++);
     }
 }
 
+void Cluster::merge(Cluster& other, const bool other_first)
+{
+    const Cluster& first = other_first ? other : *this;
+    const Cluster& second = other_first ? *this : other;
+    m_peel_start = first.m_virtual_count > 0 || second.m_virtual_count == 0 ? first.m_peel_start : second.m_peel_start;
+    m_sequence = first.m_sequence;
+    m_nodes.insert(m_nodes.end(), other.m_nodes.begin(), other.m_nodes.end());
+    m_bulk_edges.insert(m_bulk_edges.end(), other.m_bulk_edges.begin(), other.m_bulk_edges.end());
+    // The boundary of `other` is appended, but ranked before or after the boundary of this cluster
+    if (other_first)
+    {
+        const long long rank_shift = m_first_rank - other.m_next_rank;
+        m_boundary.append(other.m_boundary, rank_shift);
+        m_first_rank = other.m_first_rank + rank_shift;
+    }
+    else
+    {
+        const long long rank_shift = m_next_rank - other.m_first_rank;
+        m_boundary.append(other.m_boundary, rank_shift);
+        m_next_rank = other.m_next_rank + rank_shift;
+    }
+    m_marked_count += other.m_marked_count;
+    m_virtual_count += other.m_virtual_count;
+    m_first_round = min(m_first_round, other.m_first_round);
+    m_last_round = max(m_last_round, other.m_last_round);
+}
+
+// The non-const graph compresses the paths of its cluster forest on the way, the const one leaves them alone
+template <typename Graph>
+void Cluster::compact_boundary(Graph& graph, vector<BoundaryEdge>& dropped)
+{
+    int i = 0;
+    while (i < m_boundary.size() && graph.cluster(m_boundary.leaf_nodes[i]) != this)
+        i++;
+    int kept = i;
+    for (; i < m_boundary.size(); i++)
+    {
+        if (graph.cluster(m_boundary.leaf_nodes[i]) == this && !graph.is_bulk_edge(m_boundary.edges[i]))
+        {
+            dropped.push_back(m_boundary[i]);
+            continue;
+        }
+        m_boundary.tree_nodes[kept] = m_boundary.tree_nodes[i];
+        m_boundary.leaf_nodes[kept] = m_boundary.leaf_nodes[i];
+        m_boundary.edges[kept] = m_boundary.edges[i];
+        m_boundary.growth_from_tree[kept] = m_boundary.growth_from_tree[i];
+        m_boundary.ranks[kept] = m_boundary.ranks[i];
+        kept++;
+    }
+    m_boundary.tree_nodes.resize(kept);
+    m_boundary.leaf_nodes.resize(kept);
+    m_boundary.edges.resize(kept);
+    m_boundary.growth_from_tree.resize(kept);
+    m_boundary.ranks.resize(kept);
+}
+
+template void Cluster::compact_boundary(FlatDecodingGraph& graph, vector<BoundaryEdge>& dropped);
+template void Cluster::compact_boundary(const FlatDecodingGraph& graph, vector<BoundaryEdge>& dropped);
+
 bool Cluster::is_neutral(const bool consider_virtual_nodes) const
 {
-    if (m_marked_nodes.size() % 2 == 0)
+    if (m_marked_count % 2 == 0)
         return true;
     if (consider_virtual_nodes)
-        return !m_virtual_nodes.empty();
+        return m_virtual_count > 0;
     return false;
 }
 
-bool Cluster::all_clusters_are_neutral(vector<shared_ptr<Cluster>> clusters, bool consider_virtual_nodes)
+bool Cluster::all_clusters_are_neutral(const vector<shared_ptr<Cluster>>& clusters, bool consider_virtual_nodes)
 {
     return all_of(clusters.begin(), clusters.end(),
                   [consider_virtual_nodes](const shared_ptr<Cluster>& cluster)
@@ -0,0 +1,38 @@
+#include "ClusterPool.h"
+
+using namespace std;
+
+shared_ptr<Cluster> ClusterPool::acquire(const int root, const FlatDecodingGraph& graph)
+{
+    m_stats.clusters++;
+    if (m_free.empty())
+    {
+        m_stats.allocations++;
+        return make_shared<Cluster>(root, graph);
+    }
+    auto cluster = move(m_free.back());
+    m_free.pop_back();
+    cluster->reset(root, graph);
+    return cluster;
+}
+
+void ClusterPool::release(shared_ptr<Cluster> cluster)
+{
+    // Clusters fresh from make_shared have a pooled capacity of 0 and count as allocated once already
+    if (cluster->m_pooled_capacity != 0 && cluster->capacity() > cluster->m_pooled_capacity)
+    {
+        m_stats.allocations++;
+    }
+    cluster->m_pooled_capacity = cluster->capacity();
+    m_free.push_back(move(cluster));
+}
+
+void ClusterPool::release_all(vector<shared_ptr<Cluster>>& clusters)
+{
+    m_stats.shots++;
+    for (auto& cluster : clusters)
+    {
+        release(move(cluster));
+    }
+    clusters.clear();
+}
@@ -3,3 +3,15 @@
 //
 
 #include "Decoder.h"
+
+DecodingResult Decoder::decode(std::shared_ptr<DecodingGraph> graph)
+{
+    auto result = decode(*graph->flat());
+    result.corrections.clear();
+    result.corrections.reserve(result.correction_indices.size());
+    for (const int edge : result.correction_indices)
+    {
+        result.corrections.push_back(graph->edge_at(edge));
+    }
+    return result;
+}
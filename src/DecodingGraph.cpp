@@ -2,7 +2,11 @@
 // Created by tommasopeduzzi on 1/8/24.
 //
 
+#include <algorithm>
+#include <cmath>
+
 #include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
 #include "Logger.h"
 
 using namespace std;
@@ -77,6 +81,7 @@ shared_ptr<DecodingGraph> DecodingGraph::surface_code(int D, int T) {
         }
     }
 
+    graph->build_sampling_order();
     return graph;
 }
 
@@ -179,6 +184,7 @@ shared_ptr<DecodingGraph> DecodingGraph::rotated_surface_code(int D, int T) {
         graph->addLogicalEdge(edge);
     }
 
+    graph->build_sampling_order();
     return graph;
 }
 
@@ -233,22 +239,28 @@ std::shared_ptr<DecodingGraph> DecodingGraph::repetition_code(int D, int T)
                 make_pair(rightmost_node, right_boundary_node)));
     }
 
+    graph->build_sampling_order();
     return graph;
 }
 
 std::shared_ptr<DecodingGraph> DecodingGraph::single_layer_copy(std::shared_ptr<DecodingGraph> graph)
 {
-    if (graph->code_name() == "rotated_surface_code")
+    return DecodingGraph::from_code_name(graph->code_name(), graph->d(), 1);
+}
+
+std::shared_ptr<DecodingGraph> DecodingGraph::from_code_name(const std::string& code_name, int D, int T)
+{
+    if (code_name == "rotated_surface_code")
     {
-        return DecodingGraph::rotated_surface_code(graph->d(), 1);
-    } if (graph->code_name() == "surface_code")
+        return DecodingGraph::rotated_surface_code(D, T);
+    } if (code_name == "surface_code")
     {
-        return DecodingGraph::surface_code(graph->d(), 1);
-    } if (graph->code_name() == "repetition_code")
+        return DecodingGraph::surface_code(D, T);
+    } if (code_name == "repetition_code")
     {
-        return DecodingGraph::repetition_code(graph->d(), 1);
+        return DecodingGraph::repetition_code(D, T);
     }
-    throw runtime_error("SingleLayerClAYGDecoder: Unsupported code type " + graph->code_name());
+    throw runtime_error("DecodingGraph::from_code_name: unsupported code type '" + code_name + "'");
 }
 
 optional<shared_ptr<DecodingGraphNode>> DecodingGraph::node(const DecodingGraphNode::Id id) {
@@ -278,7 +290,10 @@ optional<shared_ptr<DecodingGraphEdge>> DecodingGraph::edge(const DecodingGraphE
 }
 
 void DecodingGraph::addEdge(const shared_ptr<DecodingGraphEdge>& edge) {
+    edge->set_index(static_cast<int>(m_edges.size()));
     m_edges.push_back(edge);
+    m_flat = nullptr;
+    m_sampling_round_end.clear();
     auto [type, round, id] = edge->id();
     if (type == DecodingGraphEdge::NORMAL) {
         if (m_normal_edges.size() <= round) {
@@ -297,10 +312,13 @@ void DecodingGraph::addEdge(const shared_ptr<DecodingGraphEdge>& edge) {
 
 void DecodingGraph::addLogicalEdge(const shared_ptr<DecodingGraphEdge>& edge) {
     m_logical_edges.push_back(edge->id());
+    m_flat = nullptr;
 }
 
 void DecodingGraph::addNode(const shared_ptr<DecodingGraphNode>& node) {
+    node->set_index(static_cast<int>(m_nodes.size()));
     m_nodes.push_back(node);
+    m_flat = nullptr;
     auto id = node->id();
     if (id.type == DecodingGraphNode::Type::ANCILLA) {
         if (m_ancilla_nodes.size() <= id.round) {
@@ -320,13 +338,20 @@ set<int> DecodingGraph::logical_edge_ids() {
     return ids;
 }
 
+shared_ptr<FlatDecodingGraph> DecodingGraph::flat() {
+    if (!m_flat) {
+        m_flat = FlatDecodingGraph::from(*this);
+    }
+    return m_flat;
+}
+
 void DecodingGraph::reset() {
-    for (const auto& node: m_nodes) {
-        node->set_cluster(nullopt);
-        node->set_marked(false);
+    for (const int index: m_marked_nodes) {
+        m_nodes[index]->set_marked(false);
     }
-    for (const auto& edge: m_edges) {
-        edge->reset_growth();
+    m_marked_nodes.clear();
+    if (m_flat) {
+        m_flat->reset();
     }
 }
 
@@ -343,6 +368,11 @@ void DecodingGraph::mark(const std::vector<std::shared_ptr<DecodingGraphEdge>>&
                 continue;
             }
             node->set_marked(!node->marked());
+            m_marked_nodes.push_back(node->index());
+            if (m_flat)
+            {
+                m_flat->set_marked(node->index(), node->marked());
+            }
         }
     }
 }
@@ -364,43 +394,109 @@ std::vector<std::vector<std::shared_ptr<DecodingGraphNode>>> DecodingGraph::mark
     return marked_nodes;
 }
 
-std::vector<DecodingGraphEdge::Id> DecodingGraph::sample_errors(
+void DecodingGraph::build_sampling_order()
+{
+    m_sampling_edges.clear();
+    m_sampling_round_end = {0};
+    const auto rounds = max(m_normal_edges.size(), m_measurement_edges.size());
+    for (size_t t = 0; t < rounds; t++)
+    {
+        if (t < m_normal_edges.size())
+            for (const auto& [id, edge] : m_normal_edges[t])
+                m_sampling_edges.push_back(edge->id());
+        if (t < m_measurement_edges.size())
+            for (const auto& [id, edge] : m_measurement_edges[t])
+                m_sampling_edges.push_back(edge->id());
+        m_sampling_round_end.push_back(static_cast<int>(m_sampling_edges.size()));
+    }
+}
+
+template <typename OnError>
+void DecodingGraph::sample_faults(
     double p,
     const std::map<DecodingGraphEdge::Type, double>& noise_model,
     int sample_T,
-    std::uniform_real_distribution<double>& dis,
-    std::mt19937& gen) const
+    int lanes,
+    RandomStream& rng,
+    OnError on_error) const
 {
-    std::vector<DecodingGraphEdge::Id> error_ids;
+    if (m_sampling_round_end.empty())
+        throw runtime_error("DecodingGraph: build_sampling_order() has to be called before sampling errors");
+
     int use_T = (sample_T < 0) ? T : sample_T;
+    use_T = min(use_T, static_cast<int>(m_sampling_round_end.size()) - 1);
+    // (edge, realisation) pairs, edge-major
+    const int64_t position_count = static_cast<int64_t>(m_sampling_round_end[max(use_T, 0)]) * lanes;
 
-    for (int t = 0; t < use_T; t++)
+    // Error probability per edge type
+    double p_type[2];
+    for (const auto type : {DecodingGraphEdge::MEASUREMENT, DecodingGraphEdge::NORMAL})
     {
-        // sample normal edges at round t
-        if (t < static_cast<int>(m_normal_edges.size())) {
-            for (const auto& [id, edge] : m_normal_edges[t]) {
-                double factor = 1.0;
-                auto it = noise_model.find(DecodingGraphEdge::NORMAL);
-                if (it != noise_model.end()) factor = it->second;
-                double p_effective = p * factor;
-                if (p_effective > 0 && dis(gen) <= p_effective) {
-                    error_ids.push_back(edge->id());
-                }
-            }
+        auto it = noise_model.find(type);
+        double factor = it != noise_model.end() ? it->second : 1.0;
+        p_type[type] = std::clamp(p * factor, 0.0, 1.0);
+    }
+    const double p_max = max(p_type[DecodingGraphEdge::MEASUREMENT], p_type[DecodingGraphEdge::NORMAL]);
+    if (p_max <= 0 || position_count == 0)
+        return;
+
+    // Candidates are sampled with the largest probability p_max, the number of positions skipped until the next
+    // candidate being geometrically distributed. A candidate is then accepted with probability p_type / p_max,
+    // which makes every edge faulty independently with exactly its own probability.
+    const double log_miss = log1p(-p_max);
+    int64_t position = -1;
+    while (true)
+    {
+        if (p_max < 1.0)
+        {
+            // 1 - uniform() lies in (0, 1], so the logarithm is finite
+            const double skip = floor(log(1.0 - rng.uniform()) / log_miss);
+            if (skip >= static_cast<double>(position_count - position - 1))
+                break;
+            position += static_cast<int64_t>(skip) + 1;
         }
-
-        // sample measurement edges originating at round t (measurement edges are associated with round t)
-        if (t < static_cast<int>(m_measurement_edges.size())) {
-            for (const auto& [id, edge] : m_measurement_edges[t]) {
-                double factor = 1.0;
-                auto it = noise_model.find(DecodingGraphEdge::MEASUREMENT);
-                if (it != noise_model.end()) factor = it->second;
-                double p_effective = p * factor;
-                if (p_effective > 0 && dis(gen) <= p_effective) {
-                    error_ids.push_back(edge->id());
-                }
-            }
+        else if (++position >= position_count)
+        {
+            break;
         }
+        const int i = static_cast<int>(position / lanes);
+        const double p_edge = p_type[m_sampling_edges[i].type];
+        if (p_edge == p_max || rng.uniform() * p_max < p_edge)
+            on_error(i, static_cast<int>(position % lanes));
     }
+}
+
+std::vector<DecodingGraphEdge::Id> DecodingGraph::sample_errors(
+    double p,
+    const std::map<DecodingGraphEdge::Type, double>& noise_model,
+    int sample_T,
+    RandomStream& rng) const
+{
+    std::vector<DecodingGraphEdge::Id> error_ids;
+    sample_faults(p, noise_model, sample_T, 1, rng, [&](const int i, int)
+    {
+        error_ids.push_back(m_sampling_edges[i]);
+    });
     return error_ids;
 }
+
+std::vector<std::pair<DecodingGraphEdge::Id, uint64_t>> DecodingGraph::sample_error_batch(
+    double p,
+    const std::map<DecodingGraphEdge::Type, double>& noise_model,
+    int sample_T,
+    RandomStream& rng) const
+{
+    // Positions are visited in increasing order, so all realisations of an edge are sampled consecutively
+    std::vector<std::pair<DecodingGraphEdge::Id, uint64_t>> errors;
+    int last = -1;
+    sample_faults(p, noise_model, sample_T, 64, rng, [&](const int i, const int lane)
+    {
+        if (i != last)
+        {
+            errors.emplace_back(m_sampling_edges[i], 0);
+            last = i;
+        }
+        errors.back().second |= uint64_t{1} << lane;
+    });
+    return errors;
+}
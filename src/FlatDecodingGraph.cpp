@@ -0,0 +1,499 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+
+#include "FlatDecodingGraph.h"
+
+using namespace std;
+
+// Weight of a DecodingGraph edge in growth units
+static Growth to_growth(const float weight)
+{
+    if (!isfinite(weight) || weight * GROWTH_UNITS >= UNREACHABLE_WEIGHT)
+        return UNREACHABLE_WEIGHT;
+    return static_cast<Growth>(lround(weight * GROWTH_UNITS));
+}
+
+shared_ptr<FlatDecodingGraph::Topology> FlatDecodingGraph::build_topology(DecodingGraph& graph)
+{
+    auto topology = make_shared<Topology>();
+    topology->ancilla_count_per_layer = graph.ancilla_count_per_layer();
+    topology->d = graph.d();
+    topology->t = graph.t();
+    topology->code_name = graph.code_name();
+
+    const auto nodes = graph.nodes();
+    const auto edges = graph.edges();
+    const int node_count = static_cast<int>(nodes.size());
+    const int edge_count = static_cast<int>(edges.size());
+
+    topology->node_ids.reserve(node_count);
+    int virtual_count = 0, ancilla_rounds = 0;
+    for (const auto& node : nodes)
+    {
+        auto id = node->id();
+        topology->node_ids.push_back(id);
+        if (id.type == DecodingGraphNode::VIRTUAL)
+        {
+            virtual_count = max(virtual_count, id.id + 1);
+        }
+        else
+        {
+            ancilla_rounds = max(ancilla_rounds, id.round + 1);
+            topology->ancilla_stride = max(topology->ancilla_stride, id.id + 1);
+        }
+    }
+
+    topology->edge_ids.reserve(edge_count);
+    topology->edge_nodes.reserve(edge_count);
+    topology->weights.reserve(edge_count);
+    int normal_rounds = 0, measurement_rounds = 0;
+    for (const auto& edge : edges)
+    {
+        auto id = edge->id();
+        auto [first, second] = edge->nodes();
+        topology->edge_ids.push_back(id);
+        topology->edge_nodes.emplace_back(first.lock()->index(), second.lock()->index());
+        topology->weights.push_back(to_growth(edge->weight()));
+        const auto first_id = first.lock()->id(), second_id = second.lock()->id();
+        if (first_id.type == DecodingGraphNode::ANCILLA && second_id.type == DecodingGraphNode::ANCILLA)
+            topology->ancilla_span = max(topology->ancilla_span, abs(first_id.id - second_id.id));
+        if (id.type == DecodingGraphEdge::NORMAL)
+        {
+            normal_rounds = max(normal_rounds, id.round + 1);
+            topology->normal_edge_stride = max(topology->normal_edge_stride, id.id + 1);
+        }
+        else
+        {
+            measurement_rounds = max(measurement_rounds, id.round + 1);
+            topology->measurement_edge_stride = max(topology->measurement_edge_stride, id.id + 1);
+        }
+    }
+
+    // Id -> index lookup tables
+    topology->virtual_node_index.assign(virtual_count, -1);
+    topology->ancilla_node_index.assign(ancilla_rounds * topology->ancilla_stride, -1);
+    for (int i = 0; i < node_count; i++)
+    {
+        const auto& id = topology->node_ids[i];
+        if (id.type == DecodingGraphNode::VIRTUAL)
+            topology->virtual_node_index[id.id] = i;
+        else
+            topology->ancilla_node_index[id.round * topology->ancilla_stride + id.id] = i;
+    }
+    topology->normal_edge_index.assign(normal_rounds * topology->normal_edge_stride, -1);
+    topology->measurement_edge_index.assign(measurement_rounds * topology->measurement_edge_stride, -1);
+    for (int i = 0; i < edge_count; i++)
+    {
+        const auto& id = topology->edge_ids[i];
+        if (id.type == DecodingGraphEdge::NORMAL)
+            topology->normal_edge_index[id.round * topology->normal_edge_stride + id.id] = i;
+        else
+            topology->measurement_edge_index[id.round * topology->measurement_edge_stride + id.id] = i;
+    }
+
+    // Adjacency, in the same order as DecodingGraphNode::edges()
+    topology->offsets.reserve(node_count + 1);
+    topology->adjacent_edges.reserve(2 * edge_count);
+    topology->adjacent_nodes.reserve(2 * edge_count);
+    topology->offsets.push_back(0);
+    for (int i = 0; i < node_count; i++)
+    {
+        for (const auto& edge_weak_ptr : nodes[i]->edges())
+        {
+            const int edge = edge_weak_ptr.lock()->index();
+            const auto [first, second] = topology->edge_nodes[edge];
+            topology->adjacent_edges.push_back(edge);
+            topology->adjacent_nodes.push_back(first == i ? second : first);
+        }
+        topology->offsets.push_back(static_cast<int>(topology->adjacent_edges.size()));
+    }
+
+    for (const auto& id : graph.logical_edges())
+    {
+        topology->logical_edges.push_back(topology->edge(id));
+    }
+    return topology;
+}
+
+shared_ptr<FlatDecodingGraph> FlatDecodingGraph::with_topology(shared_ptr<const Topology> topology)
+{
+    auto flat = make_shared<FlatDecodingGraph>();
+    flat->m_ancilla_count_per_layer = topology->ancilla_count_per_layer;
+    flat->D = topology->d;
+    flat->T = topology->t;
+    flat->m_node_ids = topology->node_ids;
+    flat->m_edge_ids = topology->edge_ids;
+    flat->m_edge_nodes = topology->edge_nodes;
+    flat->m_offsets = topology->offsets;
+    flat->m_adjacent_edges = topology->adjacent_edges;
+    flat->m_adjacent_nodes = topology->adjacent_nodes;
+    flat->m_virtual_node_index = topology->virtual_node_index;
+    flat->m_ancilla_stride = topology->ancilla_stride;
+    flat->m_ancilla_node_index = topology->ancilla_node_index;
+
+    const int node_count = flat->node_count();
+    const int edge_count = flat->edge_count();
+    flat->m_marked.assign(node_count, 0);
+    flat->m_node_dirty.assign(node_count, 0);
+    flat->m_edge_dirty.assign(edge_count, 0);
+    flat->m_forest = DisjointSetForest(node_count);
+    flat->m_cluster.assign(node_count, nullptr);
+    flat->m_weight.reserve(edge_count + 1);
+    flat->m_weight = topology->weights;
+    flat->m_weight.push_back(0);
+    flat->m_growth.assign(edge_count + 1, 0);
+    flat->m_bulk_edge.assign(edge_count, 0);
+    if (topology->layers > 0)
+    {
+        flat->m_layer_round.assign(topology->layers, -1);
+        flat->m_base_weight = flat->m_weight;
+    }
+    flat->m_topology = move(topology);
+    if (flat->is_ring_buffer())
+    {
+        flat->start_stream(0);
+    }
+    return flat;
+}
+
+shared_ptr<FlatDecodingGraph> FlatDecodingGraph::from(DecodingGraph& graph)
+{
+    auto flat = with_topology(build_topology(graph));
+    const auto nodes = graph.nodes();
+    for (int i = 0; i < flat->node_count(); i++)
+    {
+        if (nodes[i]->marked())
+            flat->set_marked(i, true);
+    }
+    return flat;
+}
+
+shared_ptr<FlatDecodingGraph> FlatDecodingGraph::overlay(const FlatDecodingGraph& source)
+{
+    auto flat = with_topology(source.m_topology);
+    flat->set_edge_weights(source.m_normal_weight, source.m_measurement_weight);
+    return flat;
+}
+
+shared_ptr<FlatDecodingGraph> FlatDecodingGraph::overlay(const string& code_name, const int d, const int t)
+{
+    return with_topology(shared_topology(code_name, d, t, 0));
+}
+
+shared_ptr<FlatDecodingGraph> FlatDecodingGraph::single_layer_copy(const FlatDecodingGraph& source)
+{
+    return overlay(source.code_name(), source.d(), 1);
+}
+
+shared_ptr<FlatDecodingGraph> FlatDecodingGraph::ring_buffer(const string& code_name, const int d, const int layers)
+{
+    if (layers < 3)
+        throw runtime_error("FlatDecodingGraph: a ring buffer needs at least 3 layers, got " + to_string(layers));
+    return with_topology(shared_topology(code_name, d, layers, layers));
+}
+
+shared_ptr<const FlatDecodingGraph::Topology> FlatDecodingGraph::shared_topology(const string& code_name, const int d,
+                                                                                 const int t, const int layers)
+{
+    // Decoders of all worker threads ask for their topology, usually when they decode their first shot
+    static mutex cache_mutex;
+    static map<tuple<string, int, int, int>, weak_ptr<const Topology>> cache;
+    lock_guard lock(cache_mutex);
+    auto& cached = cache[{code_name, d, t, layers}];
+    if (auto topology = cached.lock())
+        return topology;
+
+    auto graph = DecodingGraph::from_code_name(code_name, d, t);
+    if (layers == 0)
+    {
+        shared_ptr<const Topology> topology = build_topology(*graph);
+        cached = topology;
+        return topology;
+    }
+
+    // Layers are recycled round by round, so every edge has to stay within the round it is numbered with, and
+    // measurement edges within that round and the next one
+    for (const auto& edge : graph->edges())
+    {
+        const auto id = edge->id();
+        for (const auto& weak_node : {edge->nodes().first, edge->nodes().second})
+        {
+            const auto node_id = weak_node.lock()->id();
+            if (node_id.type == DecodingGraphNode::VIRTUAL)
+                continue;
+            const bool next_round = id.type == DecodingGraphEdge::MEASUREMENT && node_id.round == id.round + 1;
+            if (node_id.round == id.round || next_round)
+                continue;
+            throw runtime_error("FlatDecodingGraph: " + code_name + " can not be decoded on a ring buffer, edge "
+                                + to_string(id.id) + " of round " + to_string(id.round) + " reaches into round "
+                                + to_string(node_id.round));
+        }
+    }
+
+    // Close the ring: connect the last layer to the first one the same way round 0 is connected to round 1.
+    // Measurement edges of the wrap are numbered one round below the edges they mirror.
+    vector<shared_ptr<DecodingGraphEdge>> wrap_edges;
+    for (const auto& edge : graph->edges())
+    {
+        const auto id = edge->id();
+        if (id.type != DecodingGraphEdge::MEASUREMENT)
+            continue;
+        auto lower = edge->nodes().first.lock();
+        auto upper = edge->nodes().second.lock();
+        if (lower->id().round > upper->id().round)
+            swap(lower, upper);
+        if (lower->id().round != 0)
+            continue;
+        auto last = graph->node({DecodingGraphNode::ANCILLA, layers - 1, lower->id().id}).value();
+        auto first = graph->node({DecodingGraphNode::ANCILLA, 0, upper->id().id}).value();
+        wrap_edges.push_back(make_shared<DecodingGraphEdge>(
+            DecodingGraphEdge::Id{DecodingGraphEdge::MEASUREMENT, (id.round + layers - 1) % layers, id.id},
+            make_pair(first, last)));
+    }
+    for (const auto& edge : wrap_edges)
+    {
+        graph->addEdge(edge);
+    }
+
+    auto topology = build_topology(*graph);
+    topology->layers = layers;
+    topology->layer_nodes.resize(layers);
+    topology->layer_edges.resize(layers);
+    for (int node = 0; node < static_cast<int>(topology->node_ids.size()); node++)
+    {
+        const auto& id = topology->node_ids[node];
+        if (id.type == DecodingGraphNode::VIRTUAL)
+            continue;
+        for (int i = topology->offsets[node]; i < topology->offsets[node + 1]; i++)
+        {
+            topology->layer_edges[id.round].push_back(topology->adjacent_edges[i]);
+        }
+        topology->layer_nodes[id.round].push_back(node);
+    }
+    for (auto& edges : topology->layer_edges)
+    {
+        ranges::sort(edges);
+        edges.erase(ranges::unique(edges).begin(), edges.end());
+    }
+    // Clusters rarely reach further ahead than a code distance, the remaining layers hold past rounds
+    topology->lookahead = min(d, (layers - 1) / 2);
+    cached = topology;
+    return topology;
+}
+
+int FlatDecodingGraph::node(DecodingGraphNode::Id id) const
+{
+    if (id.type == DecodingGraphNode::VIRTUAL)
+    {
+        if (id.id < 0 || id.id >= static_cast<int>(m_virtual_node_index.size()))
+            return -1;
+        return m_virtual_node_index[id.id];
+    }
+    if (is_ring_buffer())
+    {
+        const int layer = id.round % static_cast<int>(m_layer_round.size());
+        if (id.round < 0 || m_layer_round[layer] != id.round)
+            return -1;
+        id.round = layer;
+    }
+    if (id.id < 0 || id.id >= m_ancilla_stride || id.round < 0)
+        return -1;
+    const size_t index = static_cast<size_t>(id.round) * m_ancilla_stride + id.id;
+    if (index >= m_ancilla_node_index.size())
+        return -1;
+    return m_ancilla_node_index[index];
+}
+
+int FlatDecodingGraph::Topology::edge(const DecodingGraphEdge::Id& id) const
+{
+    const bool normal = id.type == DecodingGraphEdge::NORMAL;
+    const int stride = normal ? normal_edge_stride : measurement_edge_stride;
+    const auto& lookup = normal ? normal_edge_index : measurement_edge_index;
+    if (id.id < 0 || id.id >= stride || id.round < 0)
+        return -1;
+    const size_t index = static_cast<size_t>(id.round) * stride + id.id;
+    if (index >= lookup.size())
+        return -1;
+    return lookup[index];
+}
+
+int FlatDecodingGraph::edge(DecodingGraphEdge::Id id) const
+{
+    if (is_ring_buffer())
+    {
+        const int layer = id.round % static_cast<int>(m_layer_round.size());
+        if (id.round < 0 || m_layer_round[layer] != id.round)
+            return -1;
+        id.round = layer;
+    }
+    return m_topology->edge(id);
+}
+
+void FlatDecodingGraph::reset()
+{
+    for (const int node : m_dirty_nodes)
+    {
+        m_marked[node] = 0;
+        m_forest.remove(node);
+        m_node_dirty[node] = 0;
+    }
+    for (const int edge : m_dirty_edges)
+    {
+        m_growth[edge] = 0;
+        m_bulk_edge[edge] = 0;
+        m_edge_dirty[edge] = 0;
+    }
+    m_dirty_nodes.clear();
+    m_dirty_edges.clear();
+}
+
+void FlatDecodingGraph::mark(const std::vector<int>& error_edges)
+{
+    for (const int edge : error_edges)
+    {
+        for (const int node : {m_edge_nodes[edge].first, m_edge_nodes[edge].second})
+        {
+            if (is_virtual(node))
+                continue;
+            set_marked(node, !m_marked[node]);
+        }
+    }
+}
+
+vector<vector<int>> FlatDecodingGraph::marked_nodes_by_round() const
+{
+    vector<vector<int>> marked_nodes(T);
+    for (int node = 0; node < node_count(); node++)
+    {
+        if (m_marked[node])
+        {
+            marked_nodes[m_node_ids[node].round].push_back(node);
+        }
+    }
+    return marked_nodes;
+}
+
+bool FlatDecodingGraph::edge_active(const int edge) const
+{
+    if (!is_ring_buffer())
+        return true;
+    int rounds[2];
+    int ancillas = 0;
+    for (const int node : {m_edge_nodes[edge].first, m_edge_nodes[edge].second})
+    {
+        if (is_virtual(node))
+            continue;
+        const int round = m_layer_round[m_node_ids[node].round];
+        if (round < 0)
+            return false;
+        rounds[ancillas++] = round;
+    }
+    if (ancillas < 2)
+        return true;
+    const int distance = m_edge_ids[edge].type == DecodingGraphEdge::MEASUREMENT ? 1 : 0;
+    return abs(rounds[0] - rounds[1]) == distance;
+}
+
+void FlatDecodingGraph::update_weight(const int edge)
+{
+    m_weight[edge] = edge_active(edge) ? m_base_weight[edge] : UNREACHABLE_WEIGHT;
+}
+
+void FlatDecodingGraph::set_edge_weights(const Growth normal, const Growth measurement)
+{
+    if (normal == m_normal_weight && measurement == m_measurement_weight)
+        return;
+    m_normal_weight = normal;
+    m_measurement_weight = measurement;
+    for (int edge = 0; edge < edge_count(); edge++)
+    {
+        const Growth weight = edge_type(edge) == DecodingGraphEdge::NORMAL ? normal : measurement;
+        if (is_ring_buffer())
+        {
+            m_base_weight[edge] = weight;
+            update_weight(edge);
+        }
+        else
+        {
+            m_weight[edge] = weight;
+        }
+    }
+}
+
+void FlatDecodingGraph::start_stream(const int rounds)
+{
+    m_stream_rounds = rounds;
+    for (int layer = 0; layer < static_cast<int>(m_layer_round.size()); layer++)
+    {
+        m_layer_round[layer] = layer <= m_topology->lookahead && layer < rounds ? layer : -1;
+    }
+    for (int edge = 0; edge < edge_count(); edge++)
+    {
+        update_weight(edge);
+    }
+}
+
+int FlatDecodingGraph::recycled_layer(const int round) const
+{
+    const int next_round = round + m_topology->lookahead;
+    if (!is_ring_buffer() || next_round >= m_stream_rounds)
+        return -1;
+    const int layer = next_round % static_cast<int>(m_layer_round.size());
+    return m_layer_round[layer] == next_round ? -1 : layer;
+}
+
+bool FlatDecodingGraph::recycling_blocked(const int round) const
+{
+    const int layer = recycled_layer(round);
+    if (layer < 0)
+        return false;
+    for (const int node : m_topology->layer_nodes[layer])
+    {
+        if (m_forest.contains(node))
+            return true;
+    }
+    // Clusters of neighbouring rounds must not have grown into the layer. Growth on edges without a
+    // cluster at either end is what peeled clusters left behind.
+    for (const int edge : m_topology->layer_edges[layer])
+    {
+        if (!edge_active(edge) || m_growth[edge] <= 0)
+            continue;
+        const auto [first, second] = m_edge_nodes[edge];
+        if (m_forest.contains(first) || m_forest.contains(second))
+            return true;
+    }
+    return false;
+}
+
+void FlatDecodingGraph::advance(const int round)
+{
+    const int layer = recycled_layer(round);
+    if (layer < 0)
+        return;
+    if (recycling_blocked(round))
+    {
+        throw runtime_error("FlatDecodingGraph: round " + to_string(m_layer_round[layer])
+            + " can not be recycled in round " + to_string(round) + ", it is still part of a cluster");
+    }
+
+    for (const int edge : m_topology->layer_edges[layer])
+    {
+        if (edge_active(edge))
+            m_growth[edge] = 0;
+    }
+    // Inactive edges into the layer keep their growth, it was grown towards the round that arrives now
+    m_layer_round[layer] = round + m_topology->lookahead;
+    for (const int node : m_topology->layer_nodes[layer])
+    {
+        m_marked[node] = 0;
+    }
+    for (const int edge : m_topology->layer_edges[layer])
+    {
+        update_weight(edge);
+    }
+}
@@ -0,0 +1,163 @@
+#include "GrowthKernel.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define CLAYG_X86_KERNELS
+#endif
+
+using namespace std;
+
+namespace
+{
+using Kernel = void (*)(const int*, const Growth*, int, Growth*, const Growth*, Growth*, uint64_t*);
+
+void grow_scalar(const int* edges, const Growth* increments, const int begin, const int count, Growth* growth,
+                 const Growth* weight, Growth* growth_from_tree, uint64_t* fused)
+{
+    for (int i = begin; i < count; i++)
+    {
+        const int edge = edges[i];
+        growth[edge] = static_cast<Growth>(growth[edge] + increments[i]);
+        growth_from_tree[i] = static_cast<Growth>(growth_from_tree[i] + increments[i]);
+        if (growth[edge] >= weight[edge])
+            fused[i / 64] |= uint64_t{1} << (i % 64);
+    }
+}
+
+void grow_scalar(const int* edges, const Growth* increments, const int count, Growth* growth, const Growth* weight,
+                 Growth* growth_from_tree, uint64_t* fused)
+{
+    grow_scalar(edges, increments, 0, count, growth, weight, growth_from_tree, fused);
+}
+
+#ifdef CLAYG_X86_KERNELS
+// The kernels gather 32 bits per edge, i.e. the growth of the edge and of the one after it, and keep the
+// sign-extended lower half
+
+__attribute__((target("avx2")))
+__m256i low_half(const __m256i words)
+{
+    return _mm256_srai_epi32(_mm256_slli_epi32(words, 16), 16);
+}
+
+// AVX2 can gather but not scatter, the new growth is written back lane by lane
+__attribute__((target("avx2")))
+void grow_avx2(const int* edges, const Growth* increments, const int count, Growth* growth, const Growth* weight,
+               Growth* growth_from_tree, uint64_t* fused)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(edges + i));
+        const __m128i increment = _mm_loadu_si128(reinterpret_cast<const __m128i*>(increments + i));
+        const __m256i grown = low_half(_mm256_add_epi32(
+            _mm256_i32gather_epi32(reinterpret_cast<const int*>(growth), index, 2), _mm256_cvtepi16_epi32(increment)));
+        alignas(32) int32_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), grown);
+        for (int lane = 0; lane < 8; lane++)
+            growth[edges[i + lane]] = static_cast<Growth>(lanes[lane]);
+        auto* from_tree = reinterpret_cast<__m128i*>(growth_from_tree + i);
+        _mm_storeu_si128(from_tree, _mm_add_epi16(_mm_loadu_si128(from_tree), increment));
+        const __m256i edge_weight = low_half(_mm256_i32gather_epi32(reinterpret_cast<const int*>(weight), index, 2));
+        const int short_of_weight = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(edge_weight, grown)));
+        fused[i / 64] |= static_cast<uint64_t>(~short_of_weight & 0xff) << (i % 64);
+    }
+    grow_scalar(edges, increments, i, count, growth, weight, growth_from_tree, fused);
+}
+
+// The AVX-512 kernel uses the zero-masked forms of the intrinsics with all lanes selected. The unmasked forms
+// start from an undefined register, which GCC reports as maybe uninitialized.
+constexpr __mmask16 ALL_LANES = 0xffff;
+
+__attribute__((target("avx512f")))
+__m512i low_half(const __m512i words)
+{
+    return _mm512_maskz_srai_epi32(ALL_LANES, _mm512_maskz_slli_epi32(ALL_LANES, words, 16), 16);
+}
+
+__attribute__((target("avx512f")))
+__m512i gather(const __m512i index, const Growth* values)
+{
+    return _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), ALL_LANES, index, values, 2);
+}
+
+// AVX-512 can only scatter 32 bits per lane, which would overwrite the neighbouring edge, so the new growth
+// is written back lane by lane as well
+__attribute__((target("avx512f")))
+void grow_avx512(const int* edges, const Growth* increments, const int count, Growth* growth, const Growth* weight,
+                 Growth* growth_from_tree, uint64_t* fused)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m512i index = _mm512_loadu_si512(edges + i);
+        const __m256i increment = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(increments + i));
+        const __m512i grown = low_half(_mm512_add_epi32(gather(index, growth),
+                                                        _mm512_maskz_cvtepi16_epi32(ALL_LANES, increment)));
+        alignas(32) Growth lanes[16];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm512_maskz_cvtepi32_epi16(ALL_LANES, grown));
+        for (int lane = 0; lane < 16; lane++)
+            growth[edges[i + lane]] = lanes[lane];
+        auto* from_tree = reinterpret_cast<__m256i*>(growth_from_tree + i);
+        _mm256_storeu_si256(from_tree, _mm256_add_epi16(_mm256_loadu_si256(from_tree), increment));
+        const __mmask16 reached = _mm512_cmpge_epi32_mask(grown, low_half(gather(index, weight)));
+        fused[i / 64] |= static_cast<uint64_t>(reached) << (i % 64);
+    }
+    grow_scalar(edges, increments, i, count, growth, weight, growth_from_tree, fused);
+}
+#endif
+
+struct NamedKernel
+{
+    const char* name;
+    Kernel kernel;
+};
+
+bool cpu_supports(const string& name)
+{
+    if (name == "scalar")
+        return true;
+#ifdef CLAYG_X86_KERNELS
+    __builtin_cpu_init();
+    if (name == "avx2")
+        return __builtin_cpu_supports("avx2");
+    if (name == "avx512")
+        return __builtin_cpu_supports("avx512f");
+#endif
+    return false;
+}
+
+NamedKernel find_kernel(const string& name)
+{
+#ifdef CLAYG_X86_KERNELS
+    if (name == "avx512" || (name == "auto" && cpu_supports("avx512")))
+        return {"avx512", grow_avx512};
+    if (name == "avx2" || (name == "auto" && cpu_supports("avx2")))
+        return {"avx2", grow_avx2};
+#endif
+    return {"scalar", grow_scalar};
+}
+
+NamedKernel selected_kernel = find_kernel("auto");
+}
+
+bool GrowthKernel::is_supported(const string& name)
+{
+    return name == "auto" || cpu_supports(name);
+}
+
+void GrowthKernel::select(const string& name)
+{
+    selected_kernel = find_kernel(name);
+}
+
+const char* GrowthKernel::selected()
+{
+    return selected_kernel.name;
+}
+
+void GrowthKernel::grow(const int* edges, const Growth* increments, const int count, Growth* growth,
+                        const Growth* weight, Growth* growth_from_tree, uint64_t* fused)
+{
+    selected_kernel.kernel(edges, increments, count, growth, weight, growth_from_tree, fused);
+}
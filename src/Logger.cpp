@@ -3,9 +3,11 @@
 #include <iostream>
 #include <sstream>
 #include <chrono>
+#include <unordered_set>
 
 #include "Logger.h"
 #include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
 #include "Cluster.h"
 
 Logger logger;
@@ -59,7 +61,7 @@ string Logger::get_run_id() const {
     return run_id;
 }
 
-void Logger::log_decoding_step(const std::vector<std::shared_ptr<Cluster>>& clusters, const std::string& decoder, int step, int current_round) const {
+void Logger::log_decoding_step(const FlatDecodingGraph& graph, const std::vector<std::shared_ptr<Cluster>>& clusters, const std::string& decoder, int step, int current_round) const {
     if (!dump_enabled) return;
     // FIXME: do this in decoder instead of here
     std::ostringstream content;
@@ -67,33 +69,29 @@ void Logger::log_decoding_step(const std::vector<std::shared_ptr<Cluster>>& clus
         content << "current_round=" << current_round << "\n";
     }
     for (const auto& cluster : clusters) {
-        auto cluster_root = cluster->root().lock();
-        int cluster_id = cluster_root->id().id;
-        cluster_id += cluster->root().lock()->id().round * 1000;
-        for (const auto& edge : cluster->edges()) {
-            // check if edge is in boundary
-            bool in_boundary = false;
-            for (const auto& boundary : cluster->boundary())
-            {
-                if (boundary.edge == edge)
-                {
-                    in_boundary = true;
-                    break;
-                }
-            }
-            if (in_boundary) continue;
-            content << edge->id().type << "-" << edge->id().round << "-" << edge->id().id;
-            auto tree_node = edge->nodes().first.lock();
-            content << "," << tree_node->id().type << "-" << tree_node->id().round << "-" << tree_node->id().id;
+        auto cluster_root = graph.node_id(cluster->root());
+        int cluster_id = cluster_root.id;
+        cluster_id += cluster_root.round * 1000;
+        const auto& boundary = cluster->boundary();
+        std::unordered_set<int> boundary_edges(boundary.edges.begin(), boundary.edges.end());
+        for (const int edge : cluster->edges()) {
+            if (boundary_edges.contains(edge)) continue;
+            auto edge_id = graph.edge_id(edge);
+            content << edge_id.type << "-" << edge_id.round << "-" << edge_id.id;
+            auto tree_node = graph.node_id(graph.edge_nodes(edge).first);
+            content << "," << tree_node.type << "-" << tree_node.round << "-" << tree_node.id;
             content << "," << "1.0" << "," << cluster_id << "\n";
         }
-        for (const auto& boundary : cluster->boundary()) {
-            if (boundary.growth_from_tree == 0) continue;
-            content << boundary.edge->id().type << "-" << boundary.edge->id().round << "-" << boundary.edge->id().id;
+        for (int i = 0; i < boundary.size(); i++) {
+            if (boundary.growth_from_tree[i] == 0) continue;
+            auto edge_id = graph.edge_id(boundary.edges[i]);
+            content << edge_id.type << "-" << edge_id.round << "-" << edge_id.id;
             // log tree node
-            content << "," << boundary.tree_node->id().type << "-" << boundary.tree_node->id().round << "-" << boundary.tree_node->id().id;
+            auto tree_node = graph.node_id(boundary.tree_nodes[i]);
+            content << "," << tree_node.type << "-" << tree_node.round << "-" << tree_node.id;
             // log edge growth
-            content << "," << boundary.growth_from_tree << "," << cluster_id << "\n";
+            content << "," << static_cast<float>(boundary.growth_from_tree[i]) / GROWTH_UNITS;
+            content << "," << cluster_id << "\n";
         }
     }
     std::string dir = dump_dir_ + "/" + run_id + "/" + decoder;
@@ -233,6 +231,40 @@ void Logger::log_growth_steps(double p, const std::map<double, int>& frequencies
     }
 }
 
+void Logger::log_latency_entry(double p, double mean_round_latency, double max_round_latency, double mean_finish_latency, int runs, const std::string& decoder_name) {
+    std::string filename = results_dir_ + "/latency/"+ decoder_name + "_";
+    if (distance_ > 0) {
+        filename += "d=" + std::to_string(distance_) + "_";
+    }
+    if (rounds_ > 0) {
+        filename += "t=" + std::to_string(rounds_) + "_";
+    }
+    if (filename.back() == '_') {
+        filename.pop_back(); // remove trailing underscore
+    }
+    filename += ".txt";
+    std::ostringstream line;
+    line << p << "\t" << mean_round_latency << "\t" << max_round_latency << "\t" << mean_finish_latency << "\t" << runs << "\n";
+    write_to_file(filename, line.str(), true);
+}
+
+void Logger::log_backlog(double p, const std::map<int, int>& frequencies, const std::string& decoder_name) {
+    std::string filename = results_dir_ + "/backlog/"+ decoder_name + "_";
+    if (distance_ > 0) {
+        filename += "d=" + std::to_string(distance_) + "_";
+    }
+    if (rounds_ > 0) {
+        filename += "t=" + std::to_string(rounds_) + "_";
+    }
+    filename += "p=" + std::to_string(p);
+    filename += ".txt";
+    for (const auto& [steps, count] : frequencies) {
+        std::ostringstream line;
+        line << steps << "\t" << count << "\n";
+        write_to_file(filename, line.str(), true);
+    }
+}
+
 void Logger::log_progress(int current, int total, double p, int D, int interval_ms) {
     static auto last = std::chrono::steady_clock::now();
     auto now = std::chrono::steady_clock::now();
@@ -252,6 +284,8 @@ void Logger::set_results_dir(const std::string& dir) {
     std::filesystem::create_directories(results_dir_ + "/results");
     std::filesystem::create_directories(results_dir_ + "/idling");
     std::filesystem::create_directories(results_dir_ + "/steps");
+    std::filesystem::create_directories(results_dir_ + "/latency");
+    std::filesystem::create_directories(results_dir_ + "/backlog");
 }
 
 void Logger::set_dump_dir(const std::string& dir) {
@@ -5,72 +5,82 @@
 #include "LogicalComputer.h"
 
 #include <algorithm>
+#include <bit>
 
 #include "UnionFindDecoder.h"
 #include "Decoder.h"
 
-LogicalComputer::LogicalComputer(const std::shared_ptr<DecodingGraph>& graph)
+LogicalComputer::LogicalComputer(const std::shared_ptr<DecodingGraph>& graph, size_t lookup_table_budget)
+    : graph_(graph)
 {
     // cache logical edges
     logical_edge_ids_ = graph->logical_edge_ids();
 
     // create reusable single-layer graph
-    scratch_graph_ = DecodingGraph::single_layer_copy(graph);
-    scratch_graph_nodes_ = scratch_graph_->nodes();
+    scratch_graph_ = DecodingGraph::single_layer_copy(graph)->flat();
 
-    num_edges_ = static_cast<int>(scratch_graph_->edges().size());
-    num_nodes_ = static_cast<int>(scratch_graph_->nodes().size());
+    // Per-edge arrays are indexed by DecodingGraphEdge::Id::id, which is not dense (the repetition code skips
+    // id D), so they span the largest id of any edge rather than the number of edges
+    num_edges_ = 0;
+    for (const auto& edge : graph->edges())
+        num_edges_ = std::max(num_edges_, edge->id().id + 1);
+    num_nodes_ = scratch_graph_->node_count();
 
     final_measurement_.resize(num_edges_);
+    idling_plane_.resize(num_edges_);
+    defect_plane_.resize(num_nodes_);
+
+    is_logical_edge_.resize(num_edges_);
+    for (int eid : logical_edge_ids_)
+        is_logical_edge_[eid] = 1;
 
     // cache node -> edge ids
     node_edge_ids_.resize(num_nodes_);
 
     for (int i = 0; i < num_nodes_; ++i) {
-        for (auto& w : scratch_graph_nodes_[i]->edges()) {
-            auto e = w.lock();
-            node_edge_ids_[i].push_back(e->id().id);
+        for (int e : scratch_graph_->incident_edges(i)) {
+            node_edge_ids_[i].push_back(scratch_graph_->edge_id(e).id);
         }
     }
 
     cache_.reserve(MAX_CACHE);
+    syndrome_.resize((num_nodes_ + 63) / 64);
+
+    // Two bits per syndrome
+    if (num_nodes_ < 40 && (uint64_t{1} << num_nodes_) / 4 <= lookup_table_budget) {
+        use_lookup_table_ = true;
+        const size_t words = std::max<size_t>(1, (uint64_t{1} << num_nodes_) / 64);
+        lookup_known_.assign(words, 0);
+        lookup_parity_.assign(words, 0);
+    }
 }
 
 void LogicalComputer::clear_cache()
 {
     cache_.clear();
-    cache_fifo_.clear();
+    cache_lru_.clear();
 }
 
-uint64_t LogicalComputer::hash_idling(
-    const std::vector<std::shared_ptr<DecodingGraphEdge>>& idling_errors) const
+size_t LogicalComputer::SyndromeHash::operator()(const Syndrome& syndrome) const
 {
     uint64_t h = 1469598103934665603ULL;
 
-    for (auto& e : idling_errors) {
-        uint64_t x = static_cast<uint64_t>(e->id().id);
+    for (uint64_t x : syndrome) {
         h ^= x + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
     }
 
     return h;
 }
 
-int LogicalComputer::compute(
+void LogicalComputer::apply_bulk(
     const std::vector<std::shared_ptr<DecodingGraphEdge>>& bulk_errors,
-    const std::vector<std::shared_ptr<DecodingGraphEdge>>& idling_errors,
     const DecodingResult& decoding_result)
 {
-    // Check if this set of idling errors has already been computed
-    uint64_t key = hash_idling(idling_errors);
-    auto it = cache_.find(key);
-    if (it != cache_.end())
-        return it->second;
-
     // Reset final measurements
     std::fill(final_measurement_.begin(),
               final_measurement_.end(), 0);
 
-    // Apply errors up to considered round, corrections, and idling errors
+    // Apply errors up to considered round and corrections
     int consider = decoding_result.considered_up_to_round;
     auto apply = [&](const auto& vec)
     {
@@ -82,41 +92,169 @@ int LogicalComputer::compute(
 
     apply(bulk_errors);
     apply(decoding_result.corrections);
-    apply(idling_errors);
+}
 
-    // Compute final classical syndrome on the single-layer graph
-    scratch_graph_->reset();
+int LogicalComputer::evaluate_final_measurement()
+{
+    // Compute logical parity of logical
+    uint8_t logical = 0;
+    for (int eid : logical_edge_ids_)
+        logical ^= final_measurement_[eid];
+
+    // Compute final classical syndrome on the single-layer graph, one bit per node
+    std::fill(syndrome_.begin(), syndrome_.end(), 0);
     for (int i = 0; i < num_nodes_; ++i) {
-        bool defect = false;
+        uint64_t defect = 0;
         for (int eid : node_edge_ids_[i])
             defect ^= final_measurement_[eid];
 
-        scratch_graph_nodes_[i]->set_marked(defect);
+        syndrome_[i >> 6] |= defect << (i & 63);
     }
 
-    // Do final classical decoding step
-    UnionFindDecoder uf;
-    auto classical = uf.decode(scratch_graph_);
+    return logical ^ correction_parity();
+}
 
-    for (auto& e : classical.corrections)
-        final_measurement_[e->id().id] ^= 1;
+int LogicalComputer::correction_parity()
+{
+    if (use_lookup_table_) {
+        const uint64_t index = syndrome_[0];
+        const size_t word = index >> 6;
+        const uint64_t bit = uint64_t{1} << (index & 63);
+        if (!(lookup_known_[word] & bit)) {
+            if (decode_syndrome())
+                lookup_parity_[word] |= bit;
+            lookup_known_[word] |= bit;
+        }
+        return (lookup_parity_[word] & bit) != 0;
+    }
 
-    // Compute logical parity of logical
-    uint8_t logical = 0;
-    for (int eid : logical_edge_ids_)
-        logical ^= final_measurement_[eid];
+    auto it = cache_.find(syndrome_);
+    if (it != cache_.end()) {
+        ++cache_hits_;
+        cache_lru_.splice(cache_lru_.begin(), cache_lru_, it->second);
+        return it->second->second;
+    }
+    ++cache_misses_;
 
-    int result = logical;
+    int parity = decode_syndrome();
 
-    // Cache result
+    // Reuse the least recently used entry if the cache is full
     if (cache_.size() >= MAX_CACHE) {
-        uint64_t old = cache_fifo_.front();
-        cache_fifo_.pop_front();
-        cache_.erase(old);
+        cache_.erase(cache_lru_.back().first);
+        cache_lru_.splice(cache_lru_.begin(), cache_lru_, std::prev(cache_lru_.end()));
+        cache_lru_.front() = {syndrome_, parity};
+    } else {
+        cache_lru_.emplace_front(syndrome_, parity);
     }
+    cache_.emplace(syndrome_, cache_lru_.begin());
 
-    cache_[key] = result;
-    cache_fifo_.push_back(key);
+    return parity;
+}
+
+int LogicalComputer::decode_syndrome()
+{
+    scratch_graph_->reset();
+    for (size_t word = 0; word < syndrome_.size(); ++word)
+        for (uint64_t bits = syndrome_[word]; bits; bits &= bits - 1)
+            scratch_graph_->set_marked(static_cast<int>(word * 64 + std::countr_zero(bits)), true);
 
-    return result;
+    // Do final classical decoding step
+    UnionFindDecoder uf;
+    auto classical = uf.decode(*scratch_graph_);
+
+    uint8_t parity = 0;
+    for (int e : classical.correction_indices)
+        parity ^= is_logical_edge_[scratch_graph_->edge_id(e).id];
+    return parity;
+}
+
+int LogicalComputer::compute(
+    const std::vector<std::shared_ptr<DecodingGraphEdge>>& bulk_errors,
+    const std::vector<std::shared_ptr<DecodingGraphEdge>>& idling_errors,
+    const DecodingResult& decoding_result)
+{
+    apply_bulk(bulk_errors, decoding_result);
+    for (auto& e : idling_errors) {
+        if (e->id().round <= decoding_result.considered_up_to_round)
+            final_measurement_[e->id().id] ^= 1;
+    }
+
+    return evaluate_final_measurement();
+}
+
+int LogicalComputer::compute_idling_failures(
+    const std::vector<std::shared_ptr<DecodingGraphEdge>>& bulk_errors,
+    const DecodingResult& decoding_result,
+    double p_idling,
+    const std::map<DecodingGraphEdge::Type, double>& noise_model,
+    int runs,
+    RandomStream& rng)
+{
+    if (runs <= 0)
+        return 0;
+
+    // Realisations that do not change the final syndrome are decoded like the bulk alone, so they only
+    // differ from it by the parity their idling errors add to the logical
+    apply_bulk(bulk_errors, decoding_result);
+    bulk_measurement_ = final_measurement_;
+    const int bulk_result = evaluate_final_measurement();
+    // Idling errors are sampled in round 0, which is ignored if no round was considered
+    const bool apply_idling = decoding_result.considered_up_to_round >= 0;
+
+    int failures = 0;
+    std::vector<int> touched;
+    for (int start = 0; start < runs; start += 64)
+    {
+        const int lanes = std::min(64, runs - start);
+        const uint64_t lane_mask = lanes == 64 ? ~uint64_t{0} : (uint64_t{1} << lanes) - 1;
+
+        // Sample the idling bit-planes, edges sharing an id act on the same parity
+        auto batch = graph_->sample_error_batch(p_idling, noise_model, 1, rng);
+        touched.clear();
+        if (apply_idling) {
+            for (const auto& [id, mask] : batch) {
+                if (idling_plane_[id.id] == 0)
+                    touched.push_back(id.id);
+                idling_plane_[id.id] ^= mask & lane_mask;
+            }
+        }
+        std::ranges::sort(touched);
+        touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+        if (touched.empty()) {
+            failures += bulk_result * lanes;
+            continue;
+        }
+
+        // Bit-sliced logical parity and syndrome change of all realisations
+        uint64_t logical_plane = 0;
+        for (int eid : touched)
+            if (is_logical_edge_[eid])
+                logical_plane ^= idling_plane_[eid];
+        uint64_t changed = 0;
+        for (int i = 0; i < num_nodes_; ++i) {
+            uint64_t plane = 0;
+            for (int eid : node_edge_ids_[i])
+                plane ^= idling_plane_[eid];
+            defect_plane_[i] = plane;
+            changed |= plane;
+        }
+
+        const uint64_t unchanged = ~changed & lane_mask;
+        failures += std::popcount(unchanged & (bulk_result ? ~logical_plane : logical_plane));
+
+        // Decode every realisation that changes the syndrome on its own
+        for (uint64_t remaining = changed & lane_mask; remaining != 0; remaining &= remaining - 1) {
+            const uint64_t lane = remaining & -remaining;
+            final_measurement_ = bulk_measurement_;
+            for (int eid : touched)
+                if (idling_plane_[eid] & lane)
+                    final_measurement_[eid] ^= 1;
+            int result = evaluate_final_measurement();
+            failures += result;
+        }
+
+        for (int eid : touched)
+            idling_plane_[eid] = 0;
+    }
+    return failures;
 }
@@ -3,135 +3,155 @@
 //
 
 #include <algorithm>
-#include <queue>
 
 #include "PeelingDecoder.h"
 
 using namespace std;
 
-DecodingResult PeelingDecoder::decode(vector<shared_ptr<Cluster>>& clusters,
-                                                             const shared_ptr<DecodingGraph>&
-                                                             decoding_graph)
+DecodingResult PeelingDecoder::decode(const vector<shared_ptr<Cluster>>& clusters,
+                                      FlatDecodingGraph& decoding_graph, WorkerPool* pool)
 {
-    vector<shared_ptr<DecodingGraphEdge>> error_edges = {};
-    double peeling_steps = 0;
-    for (auto& cluster : clusters)
+    m_peeled.clear();
+    for (const auto& cluster : clusters)
     {
-        if (cluster->marked_nodes().empty())
+        if (cluster->marked_count() != 0)
         {
-            continue;
+            m_peeled.push_back(cluster.get());
         }
-        auto peeling_results = peel(cluster, decoding_graph);
-        auto new_error_edges = peeling_results.corrections;
-        peeling_steps = max(peeling_steps, peeling_results.decoding_steps);
-        error_edges.insert(error_edges.end(), new_error_edges.begin(), new_error_edges.end());
     }
-    return { error_edges, decoding_graph->t(), peeling_steps };
+    // Clusters are peeled in the order of their sequence numbers, not in the order they are stored in
+    ranges::sort(m_peeled, {}, &Cluster::sequence);
+    DecodingResult result;
+    result.decoding_steps = peel(m_peeled, decoding_graph, result.correction_indices, pool);
+    result.considered_up_to_round = decoding_graph.t();
+    return result;
 }
 
-DecodingResult PeelingDecoder::peel(const shared_ptr<Cluster>& cluster,
-                                                           const shared_ptr<DecodingGraph>&
-                                                           decoding_graph)
+int PeelingDecoder::peel(const Cluster& cluster, FlatDecodingGraph& decoding_graph, vector<int>& corrections)
 {
-    vector<shared_ptr<DecodingGraphNode>> spanning_forest_nodes = {};
-
-    // NOTE: vector<pair<tree_nde, edge>>
-    vector<pair<shared_ptr<DecodingGraphNode>, shared_ptr<DecodingGraphEdge>>> spanning_forest_edges
-        = {};
+    return peel<false>(m_scratch[0], cluster, decoding_graph, corrections);
+}
 
-    shared_ptr<DecodingGraphNode> start_node = nullptr;
-    for (const auto& node : cluster->nodes())
+int PeelingDecoder::peel(const vector<const Cluster*>& clusters, FlatDecodingGraph& decoding_graph,
+                         vector<int>& corrections, WorkerPool* pool)
+{
+    const int count = static_cast<int>(clusters.size());
+    if (!pool || count < MIN_CLUSTERS_PER_THREAD * pool->threads())
     {
-        if (node->id().type == DecodingGraphNode::Type::VIRTUAL)
+        int steps = 0;
+        for (const Cluster* cluster : clusters)
         {
-            start_node = node;
-            break;
+            steps = max(steps, peel<false>(m_scratch[0], *cluster, decoding_graph, corrections));
         }
+        return steps;
     }
-    if (start_node == nullptr)
+
+    const int runs = pool->threads();
+    if (static_cast<int>(m_scratch.size()) < runs)
     {
-        start_node = cluster->root().lock();
+        m_scratch.resize(runs);
     }
+    pool->run(runs, [&](const int run)
+    {
+        auto& scratch = m_scratch[run];
+        scratch.corrections.clear();
+        scratch.steps = 0;
+        for (int i = count * run / runs; i < count * (run + 1) / runs; i++)
+        {
+            scratch.steps = max(scratch.steps, peel<true>(scratch, *clusters[i], decoding_graph,
+                                                          scratch.corrections));
+        }
+    });
 
-    map<DecodingGraphNode::Id, bool> visited_nodes;
-    map<DecodingGraphNode::Id, int> distances;
-    for (const auto& node : cluster->nodes())
+    int steps = 0;
+    for (int run = 0; run < runs; run++)
     {
-        visited_nodes[node->id()] = false;
+        corrections.insert(corrections.end(), m_scratch[run].corrections.begin(), m_scratch[run].corrections.end());
+        steps = max(steps, m_scratch[run].steps);
     }
+    return steps;
+}
 
-    std::queue<std::shared_ptr<DecodingGraphNode>> node_queue;
-    node_queue.push(start_node);
-    visited_nodes[start_node->id()] = true;
-    distances[start_node->id()] = 0;
+template <bool Concurrently>
+int PeelingDecoder::peel(Scratch& scratch, const Cluster& cluster, FlatDecodingGraph& decoding_graph,
+                         vector<int>& corrections)
+{
+    const auto& nodes = cluster.nodes();
+    const int start_node = cluster.peel_start();
 
-    while (spanning_forest_edges.size() < cluster->nodes().size() - 1 && !node_queue.empty())
+    if (static_cast<int>(scratch.visited.size()) < decoding_graph.node_count())
     {
-        auto current_node = node_queue.front();
-        node_queue.pop();
+        scratch.visited.resize(decoding_graph.node_count(), 0);
+        scratch.distance.resize(decoding_graph.node_count());
+    }
+    if (++scratch.epoch == 0)
+    {
+        // Stamps of 2^32 calls ago would look current again
+        ranges::fill(scratch.visited, 0);
+        scratch.epoch = 1;
+    }
 
-        for (const auto& edge_weak : current_node->edges())
+    auto& visited = scratch.visited;
+    auto& distance = scratch.distance;
+    auto& queue = scratch.queue;
+    auto& spanning_tree = scratch.spanning_tree;
+    const uint32_t epoch = scratch.epoch;
+    queue.clear();
+    spanning_tree.clear();
+    queue.push_back(start_node);
+    visited[start_node] = epoch;
+    distance[start_node] = 0;
+    int depth = 0;
+
+    // Other threads peel other clusters at the same time, so only the path-compressing lookup of the serial
+    // path may write to the cluster forest
+    const auto& graph = decoding_graph;
+    const size_t tree_edges = nodes.size() - 1;
+    for (size_t head = 0; spanning_tree.size() < tree_edges && head < queue.size(); head++)
+    {
+        const int current_node = queue[head];
+        const auto edges = graph.incident_edges(current_node);
+        const auto neighbors = graph.neighbors(current_node);
+        for (size_t i = 0; i < edges.size(); i++)
         {
-            auto edge = edge_weak.lock();
-
-            auto neighbor = edge->other_node(current_node).lock();
-            if (!neighbor || visited_nodes[neighbor->id()]) continue;
-            if (!neighbor->cluster().has_value())
-            {
-                continue; // skip nodes not in a cluster
-            }
-            if (neighbor->cluster().value().lock() != cluster)
+            const int neighbor = neighbors[i];
+            if (visited[neighbor] == epoch) continue;
+            if (!graph.edge_active(edges[i])) continue;
+            const Cluster* neighbor_cluster = Concurrently ? graph.cluster(neighbor)
+                                                           : decoding_graph.cluster(neighbor);
+            if (neighbor_cluster != &cluster)
             {
-                continue;
+                continue; // skip nodes not in this cluster
             }
 
-            visited_nodes[neighbor->id()] = true;
-            distances[neighbor->id()] = distances[current_node->id()] + 1;
-            spanning_forest_edges.emplace_back(current_node, edge);
-            node_queue.push(neighbor);
+            visited[neighbor] = epoch;
+            distance[neighbor] = distance[current_node] + 1;
+            depth = max(depth, distance[neighbor]);
+            spanning_tree.emplace_back(current_node, edges[i]);
+            queue.push_back(neighbor);
         }
     }
 
-
-    vector<shared_ptr<DecodingGraphEdge>> error_edges = {};
-
-    // collect list of node ids in the spanning forest
-    vector<DecodingGraphNode::Id> spanning_forest_node_ids;
-    for (const auto& edge_pair : spanning_forest_edges)
-    {
-        auto tree_node = edge_pair.first;
-        if (std::find(spanning_forest_node_ids.begin(), spanning_forest_node_ids.end(), tree_node->id())
-            == spanning_forest_node_ids.end())
-        {
-            spanning_forest_node_ids.push_back(tree_node->id());
-        }
-    }
-    vector<DecodingGraphEdge::Id> spanning_forest_edge_ids;
-    for (const auto& edge_pair : spanning_forest_edges)
-    {
-        auto edge = edge_pair.second;
-        spanning_forest_edge_ids.push_back(edge->id());
-    }
-
-    for (int i = static_cast<int>(spanning_forest_edges.size() - 1); i >= 0; i--)
+    // Peel from the leaves towards the start node
+    for (auto it = spanning_tree.rbegin(); it != spanning_tree.rend(); ++it)
     {
-        auto tree_node = spanning_forest_edges[i].first;
-        const auto edge = spanning_forest_edges[i].second;
-        auto leaf_node = edge->other_node(tree_node).lock();
+        const auto [tree_node, edge] = *it;
+        const int leaf_node = graph.other_node(edge, tree_node);
 
-        if (leaf_node->marked())
+        if (graph.marked(leaf_node))
         {
-            error_edges.push_back(edge);
-            tree_node->set_marked(!tree_node->marked());
-            leaf_node->set_marked(false);
+            corrections.push_back(edge);
+            if constexpr (Concurrently)
+            {
+                decoding_graph.set_marked_concurrently(tree_node, !graph.marked(tree_node));
+                decoding_graph.set_marked_concurrently(leaf_node, false);
+            }
+            else
+            {
+                decoding_graph.set_marked(tree_node, !graph.marked(tree_node));
+                decoding_graph.set_marked(leaf_node, false);
+            }
         }
     }
-
-    DecodingResult result;
-    result.corrections = error_edges;
-    result.considered_up_to_round = 0;
-    result.decoding_steps = ranges::max_element(distances, [](auto const& a, auto const& b)
-        { return a.second < b.second; })->second;
-
-    return result;
+    return depth;
 }
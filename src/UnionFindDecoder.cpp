@@ -3,9 +3,10 @@
 //
 
 #include <algorithm>
+#include <bit>
 #include <cmath>
 #include <iostream>
-#include <map>
+#include <utility>
 
 #include "UnionFindDecoder.h"
 #include "PeelingDecoder.h"
@@ -14,17 +15,24 @@
 
 using namespace std;
 
-static std::map<DecodingGraphEdge::Type, float> parse_growth_policy(const string& growth_policy_arg)
+// Growth is added in whole units, so the growth of a policy has to be a multiple of 1 / GROWTH_UNITS
+static Growth to_growth_units(const float growth)
+{
+    const float units = growth * GROWTH_UNITS;
+    if (units < 0 || units > GROWTH_UNITS * 8 || abs(units - round(units)) > 1e-3f) {
+        cerr << "Invalid growth in growth_policy: " << growth << "\nReason: must be a multiple of 1/"
+             << GROWTH_UNITS << " between 0 and 8" << endl;
+        exit(1);
+    }
+    return static_cast<Growth>(lround(units));
+}
+
+static GrowthPolicy parse_growth_policy(const string& growth_policy_arg)
 {
-    std::map<DecodingGraphEdge::Type, float> type_weights;
     if (growth_policy_arg.empty() || growth_policy_arg == "uniform" || growth_policy_arg == "default") {
-        type_weights[DecodingGraphEdge::NORMAL] = 0.5f;
-        type_weights[DecodingGraphEdge::MEASUREMENT] = 0.5f;
-        return type_weights;
+        return UniformGrowth{};
     } else if (growth_policy_arg == "third") {
-        type_weights[DecodingGraphEdge::NORMAL] = 1.0f/3.0f;
-        type_weights[DecodingGraphEdge::MEASUREMENT] = 1.0f/3.0f;
-        return type_weights;
+        return ThirdGrowth{};
     }
 
     float normal_weight = NAN;
@@ -58,9 +66,7 @@ static std::map<DecodingGraphEdge::Type, float> parse_growth_policy(const string
 
     if (std::isnan(normal_weight)) normal_weight = 0.5f;
     if (std::isnan(measurement_weight)) measurement_weight = 0.5f;
-    type_weights[DecodingGraphEdge::NORMAL] = normal_weight;
-    type_weights[DecodingGraphEdge::MEASUREMENT] = measurement_weight;
-    return type_weights;
+    return TypeWeightedGrowth{to_growth_units(normal_weight), to_growth_units(measurement_weight)};
 }
 
 UnionFindDecoder::UnionFindDecoder(const std::unordered_map<std::string, std::string>& args)
@@ -76,33 +82,87 @@ UnionFindDecoder::UnionFindDecoder(const std::unordered_map<std::string, std::st
     if (const auto it = args.find("growth_policy"); it != args.end()) {
         string policy = it->second;
         if (policy == "faster_backwards") {
-            this->set_growth_policy([] (const DecodingGraphNode::Id start, const DecodingGraphNode::Id end, DecodingGraphEdge::Type edge_type) {
-                if (start.round > end.round) return 1.0;
-                return 0.5;
-            });
+            this->set_growth_policy(FasterBackwardsGrowth{});
             this->decoder_name_ += "_faster_backwards_growth";
         } else {
-            auto type_weights = parse_growth_policy(policy);
-            this->set_growth_policy([type_weights] (const DecodingGraphNode::Id start,
-                                                    const DecodingGraphNode::Id end,
-                                                    DecodingGraphEdge::Type edge_type) {
-                return type_weights.at(edge_type);
-            });
+            this->set_growth_policy(parse_growth_policy(policy));
             this->decoder_name_ += "_custom_growth_" + policy;
         }
     }
+
+    if (const auto it = args.find("weighted"); it != args.end() && it->second == "true") {
+        this->set_weighted(true);
+        this->decoder_name_ += "_weighted";
+    }
+
+    // Does not change the results, so it is not part of the decoder name
+    if (const auto it = args.find("grow_threads"); it != args.end()) {
+        this->set_grow_threads(stoi(it->second));
+    }
+
+    // Neither does growing on spatial stripes, which also sets the number of grow threads
+    if (const auto it = args.find("stripes"); it != args.end()) {
+        this->set_stripes(stoi(it->second));
+    }
+}
+
+void UnionFindDecoder::set_grow_threads(const int threads)
+{
+    grow_threads_ = max(threads, 1);
+    grow_pool_ = grow_threads_ > 1 ? make_shared<WorkerPool>(grow_threads_) : nullptr;
+    stripe_load_.assign(stripes_ ? grow_threads_ : 0, 0);
+}
+
+void UnionFindDecoder::set_stripes(const int stripes)
+{
+    stripes_ = true;
+    set_grow_threads(stripes);
 }
 
+// Log-likelihood weight log((1-p)/p) of an edge that fails with probability p, relative to `reference` and
+// quantised to half edges, so that uniform growth still fuses edges after a whole number of steps
+static Growth log_likelihood_weight(const double p, const double reference)
+{
+    constexpr int MAX_HALF_EDGES = 16;
+    if (p <= 0)
+        return MAX_HALF_EDGES * GROWTH_UNITS / 2;
+    const double half_edges = round(2 * log((1 - p) / p) / reference);
+    return static_cast<Growth>(clamp(static_cast<int>(half_edges), 1, MAX_HALF_EDGES) * GROWTH_UNITS / 2);
+}
 
-DecodingResult UnionFindDecoder::decode(const shared_ptr<DecodingGraph> graph)
+void UnionFindDecoder::set_noise(const double p, const map<DecodingGraphEdge::Type, double>& noise_model)
 {
-    int consider_up_to_round_ = graph->t();
+    if (!weighted_)
+        return;
+    auto error_probability = [&](const DecodingGraphEdge::Type type)
+    {
+        const auto it = noise_model.find(type);
+        return clamp(p * (it != noise_model.end() ? it->second : 1.0), 0.0, 1.0);
+    };
+    const double p_normal = error_probability(DecodingGraphEdge::NORMAL);
+    const double p_measurement = error_probability(DecodingGraphEdge::MEASUREMENT);
+    // The most likely edges keep weight 1, so that decoding takes about as many steps as without weights
+    const double p_max = max(p_normal, p_measurement);
+    if (p_max <= 0 || p_max >= 0.5)
+    {
+        normal_weight_ = measurement_weight_ = GROWTH_UNITS;
+        return;
+    }
+    const double reference = log((1 - p_max) / p_max);
+    normal_weight_ = log_likelihood_weight(p_normal, reference);
+    measurement_weight_ = log_likelihood_weight(p_measurement, reference);
+}
+
+DecodingResult UnionFindDecoder::decode(FlatDecodingGraph& graph)
+{
+    apply_edge_weights(graph);
+    int consider_up_to_round_ = graph.t();
     if (stop_early_)
     {
-        const int buffer_region = (graph->d() + 1) / 2;
-        auto marked_nodes_by_round = graph->marked_nodes_by_round();
+        const int buffer_region = (graph.d() + 1) / 2;
+        auto marked_nodes_by_round = graph.marked_nodes_by_round();
         int last_round_with_marked_node = 0;
-        for (int round = 0; round < graph->t(); round++)
+        for (int round = 0; round < graph.t(); round++)
         {
             if (!marked_nodes_by_round[round].empty())
             {
@@ -113,164 +173,440 @@ DecodingResult UnionFindDecoder::decode(const shared_ptr<DecodingGraph> graph)
                 break;
             }
         }
-        consider_up_to_round_ = min(graph->t()-1, last_round_with_marked_node + buffer_region);
+        consider_up_to_round_ = min(graph.t()-1, last_round_with_marked_node + buffer_region);
     }
 
     // Initialize clusters
-    m_clusters = {};
-    for (const auto& node : graph->nodes())
+    cluster_pool_.release_all(m_clusters);
+    for (int node = 0; node < graph.node_count(); node++)
     {
-        if (stop_early_ && node->id().round > consider_up_to_round_)
+        if (stop_early_ && graph.node_id(node).round > consider_up_to_round_)
         {
             continue;
         }
-        if (node->marked())
+        if (graph.marked(node))
         {
-            auto cluster = make_shared<Cluster>(node);
-            m_clusters.push_back(cluster);
-            node->set_cluster(cluster);
-            cluster->add_marked_node(node);
+            auto cluster = cluster_pool_.acquire(node, graph);
+            add_cluster(cluster);
+            graph.add_cluster(node, cluster.get());
+            cluster->add_marked_node();
         }
     }
 
     double growth_steps = 0;
     int log_steps = 0;
     // Main Union Find loop
-    logger.log_decoding_step(m_clusters, decoder_name_, log_steps++, consider_up_to_round_);
+    logger.log_decoding_step(graph, m_clusters, decoder_name_, log_steps++, consider_up_to_round_);
     while (!Cluster::all_clusters_are_neutral(m_clusters))
     {
-        graph->node(DecodingGraphNode::Id{DecodingGraphNode::ANCILLA, 4, 2});
-        vector<DecodingGraphEdge::FusionEdge> fusion_edges;
-        for (const auto& cluster : m_clusters)
-        {
-            auto new_fusion_edges = grow(cluster);
-            for (const auto& fusion_edge : new_fusion_edges)
-            {
-                fusion_edges.push_back(fusion_edge);
-            }
-        }
-        logger.log_decoding_step(m_clusters, decoder_name_, log_steps++, consider_up_to_round_);
-        merge(fusion_edges);
-        logger.log_decoding_step(m_clusters, decoder_name_, log_steps++, consider_up_to_round_);
+        auto fusion_edges = grow_clusters(graph, m_clusters);
+        logger.log_decoding_step(graph, m_clusters, decoder_name_, log_steps++, consider_up_to_round_);
+        merge(graph, fusion_edges);
+        logger.log_decoding_step(graph, m_clusters, decoder_name_, log_steps++, consider_up_to_round_);
         growth_steps++;
     }
-    auto peeling_decoder_results = PeelingDecoder::decode(m_clusters, graph);
+    auto peeling_decoder_results = peeling_decoder_.decode(m_clusters, graph, grow_pool_.get());
     // Estimate that peeling decoder takes same amount of growth steps as union find
     growth_steps += peeling_decoder_results.decoding_steps;
     // All corrections arrive at the final step, where the clusters have been peeled away.
     int correction_step = log_steps;
     // Log after peeling (no more clusters)
-    logger.log_decoding_step({}, decoder_name_, log_steps++, consider_up_to_round_);
+    logger.log_decoding_step(graph, {}, decoder_name_, log_steps++, consider_up_to_round_);
     DecodingResult result;
-    result.corrections = peeling_decoder_results.corrections;
+    result.correction_indices = peeling_decoder_results.correction_indices;
     result.considered_up_to_round = consider_up_to_round_;
     result.decoding_steps = growth_steps;
-    result.correction_steps.assign(result.corrections.size(), correction_step);
+    result.correction_steps.assign(result.correction_indices.size(), correction_step);
     return result;
 }
 
-vector<DecodingGraphEdge::FusionEdge> UnionFindDecoder::grow(const shared_ptr<Cluster>& cluster)
+// Appends the fusion edges of the boundary entries `fused` in the order of their ranks, which merges may have left
+// different from the order of the entries
+static void append_fusion_edges(const Cluster::Boundary& boundary, vector<int>& fused,
+                                vector<FlatDecodingGraph::FusionEdge>& fusion_edges)
 {
-    if (cluster->is_neutral()) return {};
-    vector<DecodingGraphEdge::FusionEdge> fusion_edges;
-    vector<Cluster::BoundaryEdge> boundary_edges;
-    for (const auto& boundary_edge : cluster->boundary())
+    ranges::sort(fused, {}, [&](const int i) { return boundary.ranks[i]; });
+    for (const int i : fused)
     {
-        // Split node into node that is part of cluster and node that is not (tree and leaf nodes)
-        auto tree_node = boundary_edge.tree_node;
+        fusion_edges.push_back(FlatDecodingGraph::FusionEdge{
+            boundary.edges[i],
+            boundary.tree_nodes[i],
+            boundary.leaf_nodes[i]
+        });
+    }
+}
 
-        auto leaf_node = boundary_edge.leaf_node;
+vector<FlatDecodingGraph::FusionEdge> UnionFindDecoder::grow(FlatDecodingGraph& graph, const shared_ptr<Cluster>& cluster)
+{
+    if (cluster->is_neutral()) return {};
+    return visit([&](const auto& policy) { return grow(graph, *cluster, policy); }, growth_policy_);
+}
 
-        auto edge = boundary_edge.edge;
-        float growth = growth_policy_(tree_node->id(), leaf_node->id(), edge->type());
-        edge->add_growth(growth);
-        boundary_edge.growth_from_tree += growth;
-        boundary_edges.push_back(boundary_edge);
+template <typename Policy>
+vector<FlatDecodingGraph::FusionEdge> UnionFindDecoder::grow(FlatDecodingGraph& graph, Cluster& cluster,
+                                                             const Policy& policy)
+{
+    dropped_.clear();
+    cluster.compact_boundary(graph, dropped_);
+    for (const auto& dropped : dropped_)
+    {
+        graph.add_growth(dropped.edge, static_cast<Growth>(-dropped.growth_from_tree));
+    }
+    boundary_stats_.dropped_edges += static_cast<long long>(dropped_.size());
+    boundary_stats_.grown_clusters++;
+    boundary_stats_.grown_edges += static_cast<long long>(cluster.boundary().size());
+    boundary_stats_.max_boundary = max(boundary_stats_.max_boundary, static_cast<int>(cluster.boundary().size()));
 
-        if (edge->growth() >= edge->weight())
-        {
-            fusion_edges.push_back(DecodingGraphEdge::FusionEdge{
-                edge,
-                tree_node,
-                leaf_node
-            });
-        }
+    auto& boundary = cluster.boundary();
+    const int count = boundary.size();
+    increments_.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        increments_[i] = policy(graph.node_id(boundary.tree_nodes[i]), graph.node_id(boundary.leaf_nodes[i]),
+                                graph.edge_type(boundary.edges[i]));
     }
+    fused_.assign((count + 63) / 64, 0);
+    graph.add_growth(boundary.edges.data(), increments_.data(), count, boundary.growth_from_tree.data(),
+                     fused_.data());
 
-    cluster->set_boundary(boundary_edges);
+    fused_entries_.clear();
+    for (int word = 0; word < static_cast<int>(fused_.size()); word++)
+    {
+        for (uint64_t bits = fused_[word]; bits != 0; bits &= bits - 1)
+            fused_entries_.push_back(word * 64 + countr_zero(bits));
+    }
+    vector<FlatDecodingGraph::FusionEdge> fusion_edges;
+    append_fusion_edges(boundary, fused_entries_, fusion_edges);
     return fusion_edges;
 }
 
+vector<FlatDecodingGraph::FusionEdge> UnionFindDecoder::grow_clusters(FlatDecodingGraph& graph,
+                                                                      const vector<shared_ptr<Cluster>>& clusters)
+{
+    vector<Cluster*> growing;
+    for (const auto& cluster : clusters)
+    {
+        if (!cluster->is_neutral())
+            growing.push_back(cluster.get());
+    }
+    // Which of the clusters at both ends of an edge reports it as a fusion edge depends on the order they grow in
+    ranges::sort(growing, {}, &Cluster::sequence);
+    return visit([&](const auto& policy)
+    {
+        if (grow_pool_ && (!stripes_ || graph.has_row_bands(grow_threads_))
+            && static_cast<int>(growing.size()) >= MIN_CLUSTERS_PER_GROW_THREAD * grow_threads_)
+            return grow_concurrently(graph, growing, policy);
+        vector<FlatDecodingGraph::FusionEdge> fusion_edges;
+        for (Cluster* cluster : growing)
+        {
+            auto new_fusion_edges = grow(graph, *cluster, policy);
+            fusion_edges.insert(fusion_edges.end(), new_fusion_edges.begin(), new_fusion_edges.end());
+        }
+        return fusion_edges;
+    }, growth_policy_);
+}
+
+vector<FlatDecodingGraph::FusionEdge> UnionFindDecoder::grow_on_stripes(FlatDecodingGraph& graph,
+                                                                        const vector<shared_ptr<Cluster>>& clusters)
+{
+    vector<Cluster*> growing;
+    for (const auto& cluster : clusters)
+    {
+        if (!cluster->is_neutral())
+            growing.push_back(cluster.get());
+    }
+    if (growing.empty())
+        return {};
+    ranges::sort(growing, {}, &Cluster::sequence);
+    return visit([&](const auto& policy) { return grow_concurrently(graph, growing, policy); }, growth_policy_);
+}
 
-void UnionFindDecoder::merge(const vector<DecodingGraphEdge::FusionEdge>& fusion_edges)
+template <typename Policy>
+vector<FlatDecodingGraph::FusionEdge> UnionFindDecoder::grow_concurrently(FlatDecodingGraph& graph,
+                                                                          const vector<Cluster*>& clusters,
+                                                                          const Policy& policy)
 {
-    for (const auto& fusion_edge : fusion_edges)
+    const int count = static_cast<int>(clusters.size());
+    const int shards = grow_threads_;
+    if (static_cast<int>(cluster_growth_.size()) < count)
+        cluster_growth_.resize(count);
+    shard_grown_edges_.resize(shards);
+    auto owner = [&](const int edge)
     {
-        auto tree_node = fusion_edge.tree_node;;
-        // assert that tree node has cluster
-        assert(tree_node->cluster().has_value());
-        auto leaf_node = fusion_edge.leaf_node;
+        return stripes_ ? graph.stripe(edge, shards) : edge % shards;
+    };
 
-        auto cluster = tree_node->cluster().value().lock();
-        auto other_cluster_optional = leaf_node->cluster();
+    // Compact the boundaries and evaluate the growth policy, which only reads the graph
+    grow_pool_->run(count, [&](const int i)
+    {
+        const Cluster& cluster = *clusters[i];
+        auto& growth = cluster_growth_[i];
+        growth.dropped.clear();
+        clusters[i]->compact_boundary(as_const(graph), growth.dropped);
+        growth.shard_dropped.resize(shards);
+        growth.shard_boundary.resize(shards);
+        for (int shard = 0; shard < shards; shard++)
+        {
+            growth.shard_dropped[shard].clear();
+            growth.shard_boundary[shard].clear();
+        }
+        for (int k = 0; k < static_cast<int>(growth.dropped.size()); k++)
+        {
+            growth.shard_dropped[owner(growth.dropped[k].edge)].push_back(k);
+        }
+        const auto& boundary = cluster.boundary();
+        growth.increments.resize(boundary.size());
+        growth.fused.assign(boundary.size(), 0);
+        for (int j = 0; j < boundary.size(); j++)
+        {
+            growth.increments[j] = policy(graph.node_id(boundary.tree_nodes[j]), graph.node_id(boundary.leaf_nodes[j]),
+                                          graph.edge_type(boundary.edges[j]));
+            growth.shard_boundary[owner(boundary.edges[j])].push_back(j);
+        }
+    });
 
-        if (!other_cluster_optional.has_value())
+    // Add the growth, every thread owns the edges of one shard and visits the clusters in the same order as
+    // the serial loop, so each edge receives the same additions in the same order
+    grow_pool_->run(shards, [&](const int shard)
+    {
+        auto& grown_edges = shard_grown_edges_[shard];
+        grown_edges.clear();
+        long long load = 0;
+        for (int i = 0; i < count; i++)
         {
-            // node is not part of another cluster
-            cluster->add_node(leaf_node);
-            if (leaf_node->marked())
-                cluster->add_marked_node(leaf_node);
-            if (leaf_node->id().type == DecodingGraphNode::VIRTUAL)
-                cluster->add_virtual_node(leaf_node);
-
-            cluster->add_bulk_edge(fusion_edge.edge);
-            for (const auto& edge_weak_ptr : leaf_node->edges())
+            auto& growth = cluster_growth_[i];
+            load += static_cast<long long>(growth.shard_dropped[shard].size() + growth.shard_boundary[shard].size());
+            for (const int k : growth.shard_dropped[shard])
             {
-                auto edge = edge_weak_ptr.lock();
-                if (edge != fusion_edge.edge)
-                {
-                    cluster->add_boundary_edge(Cluster::BoundaryEdge{
-                        leaf_node,
-                        edge->other_node(leaf_node).lock(),
-                        edge
-                    });
-                }
+                const auto& dropped = growth.dropped[k];
+                graph.add_growth_concurrently(dropped.edge, static_cast<Growth>(-dropped.growth_from_tree),
+                                              grown_edges);
+            }
+            auto& boundary = clusters[i]->boundary();
+            for (const int j : growth.shard_boundary[shard])
+            {
+                const int edge = boundary.edges[j];
+                graph.add_growth_concurrently(edge, growth.increments[j], grown_edges);
+                boundary.growth_from_tree[j] = static_cast<Growth>(boundary.growth_from_tree[j] + growth.increments[j]);
+                growth.fused[j] = graph.growth(edge) >= graph.weight(edge);
             }
-            leaf_node->set_cluster(cluster);
-            continue;
         }
+        if (stripes_)
+            stripe_load_[shard] += load;
+    });
 
-        auto other_cluster = other_cluster_optional.value().lock();
-
-        if (other_cluster == cluster)
+    vector<FlatDecodingGraph::FusionEdge> fusion_edges;
+    for (int i = 0; i < count; i++)
+    {
+        const auto& growth = cluster_growth_[i];
+        const auto& boundary = clusters[i]->boundary();
+        boundary_stats_.dropped_edges += static_cast<long long>(growth.dropped.size());
+        boundary_stats_.grown_clusters++;
+        boundary_stats_.grown_edges += static_cast<long long>(boundary.size());
+        boundary_stats_.max_boundary = max(boundary_stats_.max_boundary, static_cast<int>(boundary.size()));
+        fused_entries_.clear();
+        for (int j = 0; j < boundary.size(); j++)
         {
-            continue;
+            if (growth.fused[j])
+                fused_entries_.push_back(j);
         }
+        append_fusion_edges(boundary, fused_entries_, fusion_edges);
+    }
+    for (const auto& grown_edges : shard_grown_edges_)
+    {
+        graph.record_grown_edges(grown_edges);
+    }
+    return fusion_edges;
+}
+
+void UnionFindDecoder::merge(FlatDecodingGraph& graph, const vector<FlatDecodingGraph::FusionEdge>& fusion_edges)
+{
+    if (on_stripes(graph) && static_cast<int>(fusion_edges.size()) >= MIN_FUSION_EDGES_PER_STRIPE * grow_threads_)
+    {
+        merge_on_stripes(graph, fusion_edges);
+        return;
+    }
+    vector<int> joined_nodes;
+    for (const auto& fusion_edge : fusion_edges)
+    {
+        if (Cluster* absorbed = merge<false>(graph, fusion_edge, -1, joined_nodes))
+            remove_cluster(absorbed);
+    }
+}
+
+template <bool Concurrently>
+Cluster* UnionFindDecoder::merge(FlatDecodingGraph& graph, const FlatDecodingGraph::FusionEdge& fusion_edge,
+                                 const int stripe, vector<int>& joined_nodes)
+{
+    const int tree_node = fusion_edge.tree_node;
+    // assert that tree node has cluster
+    assert(graph.cluster(tree_node) != nullptr);
+    const int leaf_node = fusion_edge.leaf_node;
+
+    Cluster* cluster = graph.cluster(tree_node);
+    Cluster* other_cluster = graph.cluster(leaf_node);
+
+    if (other_cluster == nullptr)
+    {
+        // node is not part of another cluster
+        cluster->add_node(leaf_node);
+        if (graph.marked(leaf_node))
+            cluster->add_marked_node();
+        if (graph.is_virtual(leaf_node))
+            cluster->add_virtual_node(leaf_node);
+        else
+            cluster->add_round(graph.node_id(leaf_node).round);
 
-        for (const auto& node : other_cluster->nodes())
+        cluster->add_bulk_edge(fusion_edge.edge);
+        const auto edges = graph.incident_edges(leaf_node);
+        const auto neighbors = graph.neighbors(leaf_node);
+        for (size_t i = 0; i < edges.size(); i++)
         {
-            cluster->add_node(node);
-            if (node->id().type == DecodingGraphNode::VIRTUAL)
+            // Edges to nodes that are already part of the cluster are internal. Concurrently, nodes of other
+            // stripes are never part of it, and the clusters of other stripes may be changing.
+            bool internal;
+            if constexpr (Concurrently)
+                internal = graph.node_stripe(neighbors[i], grow_threads_) == stripe
+                    && as_const(graph).cluster(neighbors[i]) == cluster;
+            else
+                internal = graph.cluster(neighbors[i]) == cluster;
+            if (edges[i] != fusion_edge.edge && !internal)
             {
-                cluster->add_virtual_node(node);
+                cluster->add_boundary_edge(Cluster::BoundaryEdge{
+                    leaf_node,
+                    neighbors[i],
+                    edges[i]
+                });
             }
-            if (node->marked())
+        }
+        if constexpr (Concurrently)
+            graph.join_cluster_concurrently(leaf_node, tree_node, fusion_edge.edge, joined_nodes);
+        else
+            graph.join_cluster(leaf_node, tree_node, fusion_edge.edge);
+        merged(*cluster);
+        return nullptr;
+    }
+
+    if (other_cluster == cluster)
+    {
+        return nullptr;
+    }
+
+    // Union by size: the smaller cluster is absorbed into the larger one. If that is the cluster of the tree
+    // node, the merged cluster still grows, reports fusion edges and peels as if it had absorbed the other one.
+    const bool absorbs_tree_side = other_cluster->size() > cluster->size();
+    if (absorbs_tree_side)
+        swap(cluster, other_cluster);
+    cluster->merge(*other_cluster, absorbs_tree_side);
+    graph.unite_clusters(tree_node, leaf_node, cluster);
+    merged(*cluster);
+    return other_cluster;
+}
+
+void UnionFindDecoder::merge_on_stripes(FlatDecodingGraph& graph,
+                                        const vector<FlatDecodingGraph::FusionEdge>& fusion_edges)
+{
+    merge_within_stripes(graph, fusion_edges);
+    exchange_stripe_borders(graph, fusion_edges);
+}
+
+void UnionFindDecoder::merge_within_stripes(FlatDecodingGraph& graph,
+                                            const vector<FlatDecodingGraph::FusionEdge>& fusion_edges)
+{
+    const int stripes = grow_threads_;
+    // A cluster lies within a stripe if all of its nodes are ancillas of that stripe
+    cluster_stripe_.assign(m_clusters.size(), UNKNOWN_STRIPE);
+    auto cluster_stripe = [&](const Cluster* cluster)
+    {
+        int& stripe = cluster_stripe_[cluster->index()];
+        if (stripe == UNKNOWN_STRIPE)
+        {
+            stripe = graph.node_stripe(cluster->root(), stripes);
+            for (const int node : cluster->nodes())
             {
-                cluster->add_marked_node(node);
+                if (graph.node_stripe(node, stripes) != stripe)
+                {
+                    stripe = -1;
+                    break;
+                }
             }
-            node->set_cluster(cluster);
         }
-        for (const auto& edge : other_cluster->edges())
+        return stripe;
+    };
+
+    // Every cluster and unclustered leaf node is a unit, the fusion edges unite the units they connect in the
+    // order they are merged serially
+    const int cluster_count = static_cast<int>(m_clusters.size());
+    merge_units_ = DisjointSetForest(cluster_count + static_cast<int>(fusion_edges.size()));
+    unit_crosses_stripes_.assign(cluster_count + fusion_edges.size(), 0);
+    node_unit_.resize(graph.node_count(), -1);
+    int unit_count = cluster_count;
+    auto unit = [&](const int node)
+    {
+        if (const Cluster* cluster = graph.cluster(node))
+            return cluster->index();
+        if (node_unit_[node] == -1)
+            node_unit_[node] = unit_count++;
+        return node_unit_[node];
+    };
+
+    fusion_edge_stripe_.assign(fusion_edges.size(), -1);
+    absorbed_clusters_.assign(fusion_edges.size(), nullptr);
+    stripe_fusion_edges_.resize(stripes);
+    stripe_joined_nodes_.resize(stripes);
+    for (int stripe = 0; stripe < stripes; stripe++)
+    {
+        stripe_fusion_edges_[stripe].clear();
+        stripe_joined_nodes_[stripe].clear();
+    }
+    for (int i = 0; i < static_cast<int>(fusion_edges.size()); i++)
+    {
+        const auto& fusion_edge = fusion_edges[i];
+        const int stripe = cluster_stripe(graph.cluster(fusion_edge.tree_node));
+        const Cluster* leaf_cluster = graph.cluster(fusion_edge.leaf_node);
+        const int leaf_stripe = leaf_cluster ? cluster_stripe(leaf_cluster)
+                                             : graph.node_stripe(fusion_edge.leaf_node, stripes);
+
+        const int tree_unit = unit(fusion_edge.tree_node);
+        const int leaf_unit = unit(fusion_edge.leaf_node);
+        for (const int u : {tree_unit, leaf_unit})
         {
-            cluster->add_bulk_edge(edge);
+            if (!merge_units_.contains(u))
+                merge_units_.make_set(u);
         }
-        for (const auto& boundary : other_cluster->boundary())
+        const bool crosses_stripes = stripe < 0 || stripe != leaf_stripe
+            || unit_crosses_stripes_[merge_units_.find(tree_unit)]
+            || unit_crosses_stripes_[merge_units_.find(leaf_unit)];
+        unit_crosses_stripes_[merge_units_.unite(tree_unit, leaf_unit)] = crosses_stripes;
+        if (!crosses_stripes)
         {
-            cluster->add_boundary_edge(boundary);
+            fusion_edge_stripe_[i] = stripe;
+            stripe_fusion_edges_[stripe].push_back(i);
         }
+    }
+    for (const auto& fusion_edge : fusion_edges)
+        node_unit_[fusion_edge.leaf_node] = -1;
 
-        auto cluster_to_be_removed = find(m_clusters.begin(), m_clusters.end(), other_cluster);
-        if (cluster_to_be_removed != m_clusters.end())
-            m_clusters.erase(cluster_to_be_removed);
+    // Merges within different stripes touch disjoint clusters and nodes
+    grow_pool_->run(stripes, [&](const int stripe)
+    {
+        for (const int i : stripe_fusion_edges_[stripe])
+            absorbed_clusters_[i] = merge<true>(graph, fusion_edges[i], stripe, stripe_joined_nodes_[stripe]);
+    });
+    for (int stripe = 0; stripe < stripes; stripe++)
+        graph.record_joined_nodes(stripe_joined_nodes_[stripe]);
+}
+
+void UnionFindDecoder::exchange_stripe_borders(FlatDecodingGraph& graph,
+                                               const vector<FlatDecodingGraph::FusionEdge>& fusion_edges)
+{
+    // Absorbed clusters are removed in serial order as well, so the clusters keep their order
+    vector<int> joined_nodes;
+    for (int i = 0; i < static_cast<int>(fusion_edges.size()); i++)
+    {
+        if (fusion_edge_stripe_[i] == -1)
+            absorbed_clusters_[i] = merge<false>(graph, fusion_edges[i], -1, joined_nodes);
+        if (absorbed_clusters_[i])
+            remove_cluster(absorbed_clusters_[i]);
     }
 }
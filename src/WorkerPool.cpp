@@ -0,0 +1,78 @@
+#include "WorkerPool.h"
+
+using namespace std;
+
+WorkerPool::WorkerPool(const int threads)
+{
+    for (int t = 1; t < threads; t++)
+    {
+        m_threads.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_start.notify_all();
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(const int count, const function<void(int)>& task)
+{
+    if (m_threads.empty() || count <= 1)
+    {
+        for (int i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+
+    {
+        lock_guard lock(m_mutex);
+        m_task = &task;
+        m_task_count = count;
+        m_next_task = 0;
+        m_busy_threads = static_cast<int>(m_threads.size());
+        m_batch++;
+    }
+    m_start.notify_all();
+    run_tasks();
+
+    unique_lock lock(m_mutex);
+    m_done.wait(lock, [this] { return m_busy_threads == 0; });
+    m_task = nullptr;
+}
+
+void WorkerPool::work()
+{
+    int batch = 0;
+    while (true)
+    {
+        {
+            unique_lock lock(m_mutex);
+            m_start.wait(lock, [&] { return m_stop || m_batch != batch; });
+            if (m_stop)
+                return;
+            batch = m_batch;
+        }
+        run_tasks();
+        {
+            lock_guard lock(m_mutex);
+            if (--m_busy_threads == 0)
+                m_done.notify_one();
+        }
+    }
+}
+
+void WorkerPool::run_tasks()
+{
+    for (int i = m_next_task++; i < m_task_count; i = m_next_task++)
+    {
+        (*m_task)(i);
+    }
+}
@@ -5,10 +5,16 @@
 #include <format>
 #include <random>
 #include <regex>
+#include <thread>
+#include <tuple>
+#include <numeric>
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 
+#include "BoundedQueue.h"
 #include "DecodingGraph.h"
+#include "GrowthKernel.h"
 #include "UnionFindDecoder.h"
 #include "ClAYGDecoder.h"
 #include "Logger.h"
@@ -118,6 +124,20 @@ unordered_map<string, string> parse_args(int argc, char* argv[]) {
         {"runs_p", "10000", [](const string& v){ stoi(v); }},
         {"runs_idling", "10000", [](const string& v){ stoi(v); }},
         {"noise_model", "phenomenological", [](const string& v){ /* free-form; parsed later */ }},
+        {"threads", "1", [](const string& v){
+            if (stoi(v) < 1) throw invalid_argument("must be at least 1");
+        }},
+        {"lookup_table_mb", "64", [](const string& v){
+            if (stoi(v) < 0) throw invalid_argument("must not be negative");
+        }},
+        {"seed", "", [](const string& v){ /* empty: draw from random_device */ if (!v.empty()) stoull(v); }},
+        {"pipeline", "false", [](const string& v){
+            if (v != "true" && v != "false")
+                throw invalid_argument("must be true or false");
+        }},
+        {"growth_kernel", "auto", [](const string& v){
+            if (!GrowthKernel::is_supported(v)) throw invalid_argument("unknown or not supported by this CPU");
+        }},
     };
 
     unordered_set<string> known_keys;
@@ -338,6 +358,113 @@ bool increment_end_condition(double const current_variable, double start, double
     return true;
 }
 
+vector<shared_ptr<Decoder>> make_decoders(const vector<DecoderConfig>& configs)
+{
+    vector<shared_ptr<Decoder>> decoders;
+    for (auto& [decoder_name, decoder_args] : configs) {
+        if (decoder_name == "uf" || decoder_name == "unionfind") {
+            decoders.push_back(make_shared<UnionFindDecoder>(decoder_args));
+        } else if (decoder_name == "clayg") {
+            decoders.push_back(make_shared<ClAYGDecoder>(decoder_args));
+        } else if (decoder_name == "single_layer_clayg" || decoder_name == "sl_clayg") {
+            decoders.push_back(make_shared<SingleLayerClAYGDecoder>(decoder_args));
+        } else {
+            cerr << "Unknown decoder: " << decoder_name << endl;
+            exit(1);
+        }
+    }
+    return decoders;
+}
+
+struct stats {
+    double rolling_sum = 0.0;
+    double sum_sq = 0.0;
+    int count = 0;
+
+    stats& operator+=(const stats& other)
+    {
+        rolling_sum += other.rolling_sum;
+        sum_sq += other.sum_sq;
+        count += other.count;
+        return *this;
+    }
+};
+
+// Wall-clock latencies of streaming decoders, in seconds
+struct latency_stats {
+    double round_sum = 0.0;
+    double round_max = 0.0;
+    int rounds = 0;
+    double finish_sum = 0.0;
+    int runs = 0;
+
+    latency_stats& operator+=(const latency_stats& other)
+    {
+        round_sum += other.round_sum;
+        round_max = max(round_max, other.round_max);
+        rounds += other.rounds;
+        finish_sum += other.finish_sum;
+        runs += other.runs;
+        return *this;
+    }
+};
+
+// Logical errors of one shot decoded by one decoder
+struct ShotOutcome {
+    int logical_without_idling = 0;
+    // Idling time constant, p_idling and how many of the runs_idling realisations failed, for every idling
+    // time constant but 0
+    vector<tuple<double, double, int>> idling;
+};
+
+// Shots on their way through the pipeline of --pipeline true, in order from first_shot on
+struct ShotBatch {
+    int first_shot = 0;
+    vector<vector<DecodingGraphEdge::Id>> error_edge_ids;
+    // Per shot and decoder, filled in by the decoding and by the evaluation stage
+    vector<vector<DecodingResult>> results;
+    vector<vector<ShotOutcome>> outcomes;
+};
+
+// Shots per batch, and batches each queue of the pipeline holds before the stage feeding it has to wait
+constexpr int PIPELINE_BATCH_SHOTS = 16;
+constexpr size_t PIPELINE_QUEUE_BATCHES = 8;
+
+// Everything needed to run shots independently of other threads: each worker owns its graph,
+// decoders and logical computer, and accumulates its own statistics which are reduced after every
+// p point. Random numbers come from per-shot RandomStreams, so results do not depend on which
+// worker ran a shot.
+struct ShotWorker {
+    shared_ptr<DecodingGraph> graph;
+    vector<shared_ptr<Decoder>> decoders;
+    LogicalComputer logical_computer;
+
+    // decoder name -> idling time constant -> total logical errors
+    map<string, map<double, stats>> errors;
+    // decoder nme -> idling time constant -> (p_idling_sum, count)
+    map<string, map<double, stats>> idling;
+    map<string, map<double, int>> growth_steps;
+    map<string, latency_stats> latency;
+    // decoder name -> growth steps deferred at the end of a round -> number of rounds
+    map<string, map<int, int>> backlog;
+
+    ShotWorker(int D, int T, const vector<DecoderConfig>& decoder_configs, size_t lookup_table_budget)
+        : graph(DecodingGraph::rotated_surface_code(D, T)),
+          decoders(make_decoders(decoder_configs)),
+          logical_computer(graph, lookup_table_budget)
+    {
+    }
+
+    void clear_statistics()
+    {
+        errors.clear();
+        idling.clear();
+        growth_steps.clear();
+        latency.clear();
+        backlog.clear();
+    }
+};
+
 int main(int argc, char* argv[])
 {
     // Parse command line arguments in format D T p_start p_end decoders results [step] [dump] [runs]
@@ -359,40 +486,60 @@ int main(int argc, char* argv[])
     logger.set_dump_enabled(dump);
     int runs_p = stoi(args["runs_p"]);
     int runs_idling = stoi(args["runs_idling"]);
+    int threads = stoi(args["threads"]);
+    // Memory budget of the final readout lookup table of each thread
+    size_t lookup_table_budget = static_cast<size_t>(stoi(args["lookup_table_mb"])) << 20;
+    if (dump && threads > 1)
+    {
+        cerr << "Invalid argument for threads: " << threads << "\nReason: dumping requires a single thread" << endl;
+        exit(1);
+    }
+    // Sampling, every decoder and the logical evaluation run on threads of their own
+    bool pipeline = args["pipeline"] == "true";
+    if (pipeline && (threads > 1 || dump))
+    {
+        cerr << "Invalid argument for pipeline: true\nReason: the pipeline runs its own threads and can not dump"
+             << endl;
+        exit(1);
+    }
 
     // Parse decoders argument (comma-separated)
-    vector<string> decoder_names;
     string decoders_arg = args["decoders"];
     auto parsed_decoders = parse_decoder_list(decoders_arg);
 
-    // Instantiate decoders
-    vector<shared_ptr<Decoder>> decoders;
-    for (auto& [decoder_name, decoder_args] : parsed_decoders) {
-        if (decoder_name == "uf" || decoder_name == "unionfind") {
-            decoders.push_back(make_shared<UnionFindDecoder>(decoder_args));
-        } else if (decoder_name == "clayg") {
-            decoders.push_back(make_shared<ClAYGDecoder>(decoder_args));
-        } else if (decoder_name == "single_layer_clayg" || decoder_name == "sl_clayg") {
-            decoders.push_back(make_shared<SingleLayerClAYGDecoder>(decoder_args));
-        } else {
-            cerr << "Unknown decoder: " << decoder_name << endl;
-            exit(1);
-        }
-    }
-
     logger.set_results_dir(args["results"]);
     logger.set_distance(D);
     logger.set_rounds(T);
 
-    auto graph = DecodingGraph::rotated_surface_code(D, T);
-    auto logical_computer = LogicalComputer(graph);
-
-    vector<shared_ptr<DecodingGraphEdge>> error_edges{};
-    vector<DecodingGraphEdge::Id> error_edge_ids{};
+    // Every shot draws its errors from streams derived from (seed, p, shot, purpose), so a run with the
+    // same seed is reproducible independently of the number of threads
+    uint64_t seed;
+    if (args["seed"].empty()) {
+        random_device rd;
+        seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+    } else {
+        seed = stoull(args["seed"]);
+    }
+    cout << "Seed: " << seed << endl;
+    GrowthKernel::select(args["growth_kernel"]);
+    cout << "Growth kernel: " << GrowthKernel::selected() << endl;
 
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_real_distribution<> dis(0, 1);
+    // Instantiate one worker (graph, decoders, logical computer) per thread
+    vector<unique_ptr<ShotWorker>> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.push_back(make_unique<ShotWorker>(D, T, parsed_decoders, lookup_table_budget));
+    }
+    const auto& decoders = workers.front()->decoders;
+    // The sampling and decoding stages of the pipeline work on graphs of their own
+    shared_ptr<DecodingGraph> sampler_graph;
+    vector<shared_ptr<DecodingGraph>> decoder_graphs;
+    if (pipeline)
+    {
+        sampler_graph = DecodingGraph::rotated_surface_code(D, T);
+        for (size_t decoder_index = 0; decoder_index < decoders.size(); decoder_index++)
+            decoder_graphs.push_back(DecodingGraph::rotated_surface_code(D, T));
+    }
 
     double p = p_start;
 
@@ -410,16 +557,19 @@ int main(int argc, char* argv[])
 
     do
     {
-        struct stats {
-            double rolling_sum = 0.0;
-            double sum_sq = 0.0;
-            int count = 0;
-        };
+        for (const auto& worker : workers)
+        {
+            for (const auto& decoder : worker->decoders)
+                decoder->set_noise(p, noise_model);
+        }
+
         // decoder name -> idling time constant -> total logical errors
         map<string, map<double, stats>> errors;
         // decoder nme -> idling time constant -> (p_idling_sum, count)
         map<string, map<double, stats>> idling;
         map<string, map<double, int>> growth_steps;
+        map<string, latency_stats> latency;
+        map<string, map<int, int>> backlog;
         for (const auto& decoder : decoders) {
             errors[decoder->decoder_name()] = {};
             // always compute for idling time constant 0.0 for last three corrected runs condition
@@ -437,81 +587,285 @@ int main(int argc, char* argv[])
         const std::string run_id_prefix = "d=" + std::to_string(D) + "_p=" + format("{:.5f}", p) + "_run=";
         int dumped_runs = 0;
         logger.set_run_id(run_id_prefix + std::to_string(dumped_runs));
-        for (int i = 0; i < runs_p; i++)
+
+        // p enters the stream keys in units of 1e-9, so replaying a single point does not depend on
+        // the rounding accumulated while stepping through the sweep
+        const auto p_key = static_cast<uint64_t>(llround(p * 1e9));
+
+        // Samples the errors of shot number `shot` on `graph`
+        auto sample_shot = [&](const shared_ptr<DecodingGraph>& graph, const int shot)
         {
             logger.prepare_dump_dir();
-            error_edge_ids = graph->sample_errors(p, noise_model, T, dis, gen);
+            RandomStream bulk_rng(seed, {p_key, static_cast<uint64_t>(shot), RandomStream::BULK});
+            auto error_edge_ids = graph->sample_errors(p, noise_model, T, bulk_rng);
             logger.log_errors(error_edge_ids);
             logger.log_graph(graph);
-            error_edges.clear();
-            for (auto id : error_edge_ids)
+            return error_edge_ids;
+        };
+
+        auto edges_of = [](const shared_ptr<DecodingGraph>& graph, const vector<DecodingGraphEdge::Id>& edge_ids)
+        {
+            vector<shared_ptr<DecodingGraphEdge>> edges;
+            for (auto id : edge_ids)
             {
                 auto edge = graph->edge(id).value();
-                error_edges.push_back(edge);
+                edges.push_back(edge);
             }
-            bool uncorrected = false;
-            std::map<string, bool> corrected_per_decoder {};
-            for (const auto& decoder : decoders) {
-                graph->reset();
-                graph->mark(error_edges);
-                auto decoding_results = decoder->decode(graph);
-                vector<DecodingGraphEdge::Id> correction_ids;
-                for (auto& edge : decoding_results.corrections) {
-                    correction_ids.push_back(edge->id());
+            return edges;
+        };
+
+        // Decodes errors that are edges of `graph` with `decoder`
+        auto decode_shot = [&](const shared_ptr<DecodingGraph>& graph, Decoder& decoder,
+                               const vector<shared_ptr<DecodingGraphEdge>>& error_edges)
+        {
+            graph->reset();
+            graph->mark(error_edges);
+            auto decoding_results = decoder.decode(graph);
+            vector<DecodingGraphEdge::Id> correction_ids;
+            for (auto& edge : decoding_results.corrections) {
+                correction_ids.push_back(edge->id());
+            }
+            logger.log_corrections(correction_ids, decoding_results.correction_steps, decoder.decoder_name());
+            return decoding_results;
+        };
+
+        // Logical errors of shot number `shot` after decoding it with the decoder called `decoder_name`
+        auto evaluate_shot = [&](LogicalComputer& logical_computer,
+                                 const vector<shared_ptr<DecodingGraphEdge>>& error_edges,
+                                 const DecodingResult& decoding_results, const int shot, const string& decoder_name)
+        {
+            ShotOutcome outcome;
+            outcome.logical_without_idling = logical_computer.compute(error_edges, {}, decoding_results);
+
+            // Each decoder gets its own idling stream, keyed by its name rather than its position in the list,
+            // so adding or removing decoders does not change the idling errors seen by the others
+            RandomStream idling_rng(seed, {p_key, static_cast<uint64_t>(shot), RandomStream::IDLING,
+                                           RandomStream::key(decoder_name)});
+            double idling_time_constant = idling_time_constant_start;
+            while (!increment_end_condition(idling_time_constant, idling_time_constant_start, idling_time_constant_end))
+            {
+                if (idling_time_constant == 0.0) // already computed above
+                {
+                    increment_by_step(idling_time_constant, idling_time_constant_step);
+                    continue;
                 }
-                logger.log_corrections(correction_ids, decoding_results.correction_steps, decoder->decoder_name());
+                double p_idling = 0.5 * (1-exp(-(decoding_results.decoding_steps/idling_time_constant)));
+                int history_idling_failures = logical_computer.compute_idling_failures(
+                    error_edges, decoding_results, p_idling, noise_model, runs_idling, idling_rng);
+                outcome.idling.push_back({idling_time_constant, p_idling, history_idling_failures});
+                increment_by_step(idling_time_constant, idling_time_constant_step);
+            }
+            return outcome;
+        };
+
+        // Adds a decoded and evaluated shot to the statistics of `worker`
+        auto record_shot = [&](ShotWorker& worker, const string& decoder_name, const DecodingResult& decoding_results,
+                               const ShotOutcome& outcome)
+        {
+            int logical_without_idling = outcome.logical_without_idling;
+            auto& decoder_errors = worker.errors[decoder_name];
+            decoder_errors[0.0].rolling_sum += logical_without_idling;
+            decoder_errors[0.0].sum_sq += logical_without_idling * logical_without_idling;
+            decoder_errors[0.0].count += 1;
+
+            double num_growth_steps = decoding_results.decoding_steps;
+            worker.growth_steps[decoder_name][num_growth_steps] += 1;
+
+            if (!decoding_results.round_latencies.empty()) {
+                // The last entry is the final flush, all others are rounds
+                auto& decoder_latency = worker.latency[decoder_name];
+                const auto& round_latencies = decoding_results.round_latencies;
+                for (size_t round = 0; round + 1 < round_latencies.size(); round++) {
+                    decoder_latency.round_sum += round_latencies[round];
+                    decoder_latency.round_max = max(decoder_latency.round_max, round_latencies[round]);
+                    decoder_latency.rounds += 1;
+                }
+                decoder_latency.finish_sum += round_latencies.back();
+                decoder_latency.runs += 1;
+            }
+
+            for (const int round_backlog : decoding_results.round_backlogs) {
+                worker.backlog[decoder_name][round_backlog] += 1;
+            }
 
-                logical_computer.clear_cache();
-                int logical_without_idling = logical_computer.compute(error_edges, {}, decoding_results);
-                if (logical_without_idling != 0) {
+            for (const auto& [idling_time_constant, p_idling, history_idling_failures] : outcome.idling)
+            {
+                worker.idling[decoder_name][idling_time_constant].rolling_sum += p_idling;
+                worker.idling[decoder_name][idling_time_constant].count += 1;
+                decoder_errors[idling_time_constant].rolling_sum += history_idling_failures;
+                decoder_errors[idling_time_constant].sum_sq += static_cast<double>(history_idling_failures) * history_idling_failures;
+                decoder_errors[idling_time_constant].count += runs_idling;
+            }
+        };
+
+        // Runs shot number `shot` on `worker`, returns whether any decoder failed to correct it
+        auto run_shot = [&](ShotWorker& worker, int shot)
+        {
+            auto& graph = worker.graph;
+            auto error_edges = edges_of(graph, sample_shot(graph, shot));
+            bool uncorrected = false;
+            for (size_t decoder_index = 0; decoder_index < worker.decoders.size(); decoder_index++) {
+                const auto& decoder = worker.decoders[decoder_index];
+                auto decoding_results = decode_shot(graph, *decoder, error_edges);
+                auto outcome = evaluate_shot(worker.logical_computer, error_edges, decoding_results, shot,
+                                             decoder->decoder_name());
+                if (outcome.logical_without_idling != 0) {
                     uncorrected = true;
                 }
-                corrected_per_decoder[decoder->decoder_name()] = (logical_without_idling == 0);
-                errors[decoder->decoder_name()][0.0].rolling_sum += logical_without_idling;
-                errors[decoder->decoder_name()][0.0].sum_sq += logical_without_idling * logical_without_idling;
-                errors[decoder->decoder_name()][0.0].count += 1;
+                record_shot(worker, decoder->decoder_name(), decoding_results, outcome);
+            }
+            return uncorrected;
+        };
 
-                double num_growth_steps = decoding_results.decoding_steps;
-                growth_steps[decoder->decoder_name()][num_growth_steps] += 1;
+        // Runs all shots as a pipeline: one thread samples them, one thread per decoder decodes them, one thread
+        // evaluates their logical errors and this thread adds them to the statistics of `worker`. The shots
+        // travel through the stages in batches and in order, so the statistics are the same as when the shots
+        // run one after the other, and a slow decoder only holds up the evaluation, not the other decoders.
+        auto run_pipeline = [&](ShotWorker& worker)
+        {
+            worker.clear_statistics();
+            const size_t decoder_count = worker.decoders.size();
+            using BatchQueue = BoundedQueue<shared_ptr<ShotBatch>>;
+            vector<unique_ptr<BatchQueue>> sampled, decoded;
+            for (size_t decoder_index = 0; decoder_index < decoder_count; decoder_index++)
+            {
+                sampled.push_back(make_unique<BatchQueue>(PIPELINE_QUEUE_BATCHES));
+                decoded.push_back(make_unique<BatchQueue>(PIPELINE_QUEUE_BATCHES));
+            }
+            BatchQueue evaluated(PIPELINE_QUEUE_BATCHES);
 
-                double idling_time_constant = idling_time_constant_start;
-                while (!increment_end_condition(idling_time_constant, idling_time_constant_start, idling_time_constant_end))
+            // A null batch tells the next stage that all shots have passed
+            vector<thread> stages;
+            stages.emplace_back([&]
+            {
+                for (int first_shot = 0; first_shot < runs_p; first_shot += PIPELINE_BATCH_SHOTS)
                 {
-                    if (idling_time_constant == 0.0) // already computed above
+                    auto batch = make_shared<ShotBatch>();
+                    batch->first_shot = first_shot;
+                    for (int shot = first_shot; shot < min(first_shot + PIPELINE_BATCH_SHOTS, runs_p); shot++)
+                        batch->error_edge_ids.push_back(sample_shot(sampler_graph, shot));
+                    batch->results.assign(batch->error_edge_ids.size(), vector<DecodingResult>(decoder_count));
+                    batch->outcomes.assign(batch->error_edge_ids.size(), vector<ShotOutcome>(decoder_count));
+                    for (const auto& queue : sampled)
+                        queue->push(batch);
+                }
+                for (const auto& queue : sampled)
+                    queue->push(nullptr);
+            });
+            for (size_t decoder_index = 0; decoder_index < decoder_count; decoder_index++)
+            {
+                stages.emplace_back([&, decoder_index]
+                {
+                    const auto& graph = decoder_graphs[decoder_index];
+                    auto& decoder = *worker.decoders[decoder_index];
+                    while (auto batch = sampled[decoder_index]->pop())
                     {
-                        increment_by_step(idling_time_constant, idling_time_constant_step);
-                        continue;
+                        for (size_t i = 0; i < batch->error_edge_ids.size(); i++)
+                            batch->results[i][decoder_index] = decode_shot(graph, decoder,
+                                                                           edges_of(graph, batch->error_edge_ids[i]));
+                        decoded[decoder_index]->push(move(batch));
                     }
-                    double p_idling = 0.5 * (1-exp(-(num_growth_steps/idling_time_constant)));
-                    idling[decoder->decoder_name()][idling_time_constant].rolling_sum += p_idling;
-                    idling[decoder->decoder_name()][idling_time_constant].count += 1;
-                    double history_idling_failures = 0.0;
-                    for (int run_idling = 0; run_idling < runs_idling; run_idling++)
+                    decoded[decoder_index]->push(nullptr);
+                });
+            }
+            stages.emplace_back([&]
+            {
+                while (true)
+                {
+                    // Every decoder passes on the same batches in the same order
+                    shared_ptr<ShotBatch> batch;
+                    for (const auto& queue : decoded)
+                        batch = queue->pop();
+                    if (!batch)
+                        break;
+                    for (size_t i = 0; i < batch->error_edge_ids.size(); i++)
                     {
-                        auto idling_error_edge_ids = graph->sample_errors(p_idling, noise_model, 1, dis, gen);
-                        auto idling_error_edges = vector<shared_ptr<DecodingGraphEdge>>{};
-                        for (auto id : idling_error_edge_ids)
-                        {
-                            auto edge = graph->edge(id).value();
-                            idling_error_edges.push_back(edge);
-                        }
-                        int logical_after_idling = logical_computer.compute(error_edges, idling_error_edges,
-                            decoding_results);
-                        history_idling_failures += logical_after_idling;
+                        const auto error_edges = edges_of(worker.graph, batch->error_edge_ids[i]);
+                        for (size_t decoder_index = 0; decoder_index < decoder_count; decoder_index++)
+                            batch->outcomes[i][decoder_index] = evaluate_shot(
+                                worker.logical_computer, error_edges, batch->results[i][decoder_index],
+                                batch->first_shot + static_cast<int>(i),
+                                worker.decoders[decoder_index]->decoder_name());
                     }
-                    errors[decoder->decoder_name()][idling_time_constant].rolling_sum += history_idling_failures;
-                    errors[decoder->decoder_name()][idling_time_constant].sum_sq += history_idling_failures * history_idling_failures;
-                    errors[decoder->decoder_name()][idling_time_constant].count += runs_idling;
-                    increment_by_step(idling_time_constant, idling_time_constant_step);
+                    evaluated.push(move(batch));
                 }
+                evaluated.push(nullptr);
+            });
+
+            int finished_shots = 0;
+            while (const auto batch = evaluated.pop())
+            {
+                for (size_t i = 0; i < batch->error_edge_ids.size(); i++)
+                {
+                    for (size_t decoder_index = 0; decoder_index < decoder_count; decoder_index++)
+                        record_shot(worker, worker.decoders[decoder_index]->decoder_name(),
+                                    batch->results[i][decoder_index], batch->outcomes[i][decoder_index]);
+                }
+                finished_shots += static_cast<int>(batch->error_edge_ids.size());
+                Logger::log_progress(finished_shots, runs_p, p, D);
+            }
+            for (auto& stage : stages)
+            {
+                stage.join();
+            }
+        };
+
+        // Shots are handed out dynamically; the first worker runs on this thread and reports progress
+        atomic<int> next_shot = 0;
+        atomic<int> finished_shots = 0;
+        auto run_worker = [&](ShotWorker& worker, bool report_progress)
+        {
+            worker.clear_statistics();
+            for (int i = next_shot++; i < runs_p; i = next_shot++)
+            {
+                bool uncorrected = run_shot(worker, i);
+                if (uncorrected && logger.is_dump_enabled())
+                {
+                    dumped_runs += 1;
+                    logger.set_run_id(run_id_prefix + std::to_string(dumped_runs));
+                }
+                int finished = ++finished_shots;
+                if (report_progress)
+                    Logger::log_progress(finished, runs_p, p, D);
+            }
+        };
+        if (pipeline)
+        {
+            run_pipeline(*workers.front());
+        }
+        else
+        {
+            vector<thread> worker_threads;
+            for (int t = 1; t < threads; t++)
+            {
+                worker_threads.emplace_back(run_worker, ref(*workers[t]), false);
             }
-            if (uncorrected)
+            run_worker(*workers.front(), true);
+            for (auto& worker_thread : worker_threads)
             {
-                dumped_runs += 1;
-                logger.set_run_id(run_id_prefix + std::to_string(dumped_runs));
+                worker_thread.join();
             }
-            Logger::log_progress(i + 1, runs_p, p, D);
         }
+
+        // Reduce the statistics of all workers
+        for (const auto& worker : workers)
+        {
+            for (const auto& [decoder_name, per_constant] : worker->errors)
+                for (const auto& [idling_time_constant, worker_stats] : per_constant)
+                    errors[decoder_name][idling_time_constant] += worker_stats;
+            for (const auto& [decoder_name, per_constant] : worker->idling)
+                for (const auto& [idling_time_constant, worker_stats] : per_constant)
+                    idling[decoder_name][idling_time_constant] += worker_stats;
+            for (const auto& [decoder_name, frequencies] : worker->growth_steps)
+                for (const auto& [steps, count] : frequencies)
+                    growth_steps[decoder_name][steps] += count;
+            for (const auto& [decoder_name, worker_latency] : worker->latency)
+                latency[decoder_name] += worker_latency;
+            for (const auto& [decoder_name, frequencies] : worker->backlog)
+                for (const auto& [steps, count] : frequencies)
+                    backlog[decoder_name][steps] += count;
+        }
+
         // Log results and average growth steps for each decoder
         results.push_back({p, {}});
         for (const auto& decoder : decoders) {
@@ -526,8 +880,77 @@ int main(int argc, char* argv[])
                 logger.log_idling_entry(average_p_idling, stats.count, p, idling_time_constant, decoder->decoder_name());
             }
             logger.log_growth_steps(p, growth_steps[decoder->decoder_name()], decoder->decoder_name());
+            if (auto it = latency.find(decoder->decoder_name()); it != latency.end()) {
+                const auto& decoder_latency = it->second;
+                logger.log_latency_entry(p, decoder_latency.round_sum / max(decoder_latency.rounds, 1),
+                    decoder_latency.round_max, decoder_latency.finish_sum / decoder_latency.runs,
+                    decoder_latency.runs, decoder->decoder_name());
+            }
+            if (auto it = backlog.find(decoder->decoder_name()); it != backlog.end()) {
+                logger.log_backlog(p, it->second, decoder->decoder_name());
+            }
         }
         increment_by_step(p, p_step);
     } while (!increment_end_condition(p, p_start, p_end) || last_three_runs_corrected());
+
+    size_t cache_hits = 0, cache_misses = 0;
+    for (const auto& worker : workers)
+    {
+        cache_hits += worker->logical_computer.cache_hits();
+        cache_misses += worker->logical_computer.cache_misses();
+    }
+    if (cache_hits + cache_misses > 0)
+        cout << "\nFinal readout cache: " << cache_hits << " hits, " << cache_misses << " misses" << endl;
+
+    for (size_t decoder_index = 0; decoder_index < decoders.size(); decoder_index++)
+    {
+        UnionFindDecoder::BoundaryStats boundary;
+        for (const auto& worker : workers)
+        {
+            const auto uf = dynamic_pointer_cast<UnionFindDecoder>(worker->decoders[decoder_index]);
+            if (!uf) continue;
+            boundary.grown_clusters += uf->boundary_stats().grown_clusters;
+            boundary.grown_edges += uf->boundary_stats().grown_edges;
+            boundary.dropped_edges += uf->boundary_stats().dropped_edges;
+            boundary.max_boundary = max(boundary.max_boundary, uf->boundary_stats().max_boundary);
+        }
+        if (boundary.grown_clusters > 0)
+            cout << "Boundary of " << decoders[decoder_index]->decoder_name() << ": "
+                 << static_cast<double>(boundary.grown_edges) / boundary.grown_clusters << " edges per grown cluster, "
+                 << boundary.max_boundary << " at most, " << boundary.dropped_edges << " internal edges dropped" << endl;
+
+        ClusterPool::Stats pool;
+        for (const auto& worker : workers)
+        {
+            const auto uf = dynamic_pointer_cast<UnionFindDecoder>(worker->decoders[decoder_index]);
+            if (!uf) continue;
+            pool.shots += uf->cluster_pool_stats().shots;
+            pool.clusters += uf->cluster_pool_stats().clusters;
+            pool.allocations += uf->cluster_pool_stats().allocations;
+        }
+        if (pool.shots > 0)
+            cout << "Clusters of " << decoders[decoder_index]->decoder_name() << ": "
+                 << static_cast<double>(pool.clusters) / pool.shots << " per shot, "
+                 << static_cast<double>(pool.allocations) / pool.shots << " allocations per shot, "
+                 << pool.allocations << " in total" << endl;
+
+        vector<long long> stripe_load;
+        for (const auto& worker : workers)
+        {
+            const auto uf = dynamic_pointer_cast<UnionFindDecoder>(worker->decoders[decoder_index]);
+            if (!uf) continue;
+            stripe_load.resize(uf->stripe_load().size());
+            for (size_t stripe = 0; stripe < stripe_load.size(); stripe++)
+                stripe_load[stripe] += uf->stripe_load()[stripe];
+        }
+        const long long total_load = accumulate(stripe_load.begin(), stripe_load.end(), 0LL);
+        if (total_load > 0)
+        {
+            cout << "Stripes of " << decoders[decoder_index]->decoder_name() << ":";
+            for (const long long load : stripe_load)
+                cout << " " << 100.0 * load / total_load << "%";
+            cout << " of " << total_load << " boundary edges grown" << endl;
+        }
+    }
     return 0;
 }
@@ -0,0 +1,153 @@
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+namespace
+{
+// ClAYG decoder whose clusters can be counted between rounds
+class CountingDecoder : public ClAYGDecoder
+{
+public:
+    using ClAYGDecoder::ClAYGDecoder;
+    using ClAYGDecoder::m_clusters;
+};
+}
+
+// Streams a pair of defects into ClAYG with an adaptive cluster lifetime and checks that their cluster is peeled
+// once it is out of reach, but kept as long as a cluster in between chains it to the latest rounds, as a cluster
+// that grows into the one in between grows on from there. Then streams sampled shots and checks that the
+// corrections clear every defect and that fewer clusters are held between rounds than with a lifetime longer
+// than the shots.
+int main()
+{
+    const int D = 7;
+    const int T = 21;
+    const unordered_map<string, string> adaptive_args = {{"cluster_lifetime", "adaptive"}};
+
+    auto graph = DecodingGraph::rotated_surface_code(D, T);
+    const auto flat = graph->flat();
+
+    // Two neighbouring ancillas and a third one, all away from the boundary, so their clusters only ever meet the
+    // clusters of the same shot
+    auto interior = [&](const int node)
+    {
+        for (const int neighbor : flat->neighbors(node))
+        {
+            if (flat->is_virtual(neighbor))
+                return false;
+        }
+        return true;
+    };
+    int pair_first = -1, pair_second = -1, between = -1;
+    for (int node = 0; node < flat->node_count() && between < 0; node++)
+    {
+        if (flat->is_virtual(node) || flat->node_id(node).round != 0 || !interior(node))
+            continue;
+        if (pair_first < 0)
+        {
+            pair_first = node;
+            for (const int edge : flat->incident_edges(node))
+            {
+                const int neighbor = flat->other_node(edge, node);
+                if (flat->edge_type(edge) == DecodingGraphEdge::NORMAL && interior(neighbor))
+                    pair_second = neighbor;
+            }
+        }
+        else if (node != pair_second)
+        {
+            between = node;
+        }
+    }
+
+    vector<int> held_alone, held_chained;
+    for (auto [held, chained] : {pair{&held_alone, false}, pair{&held_chained, true}})
+    {
+        CountingDecoder decoder(adaptive_args);
+        decoder.begin("rotated_surface_code", D, T);
+        for (int round = 0; round < T; round++)
+        {
+            vector<DecodingGraphNode::Id> defects;
+            if (round == 0)
+                defects = {flat->node_id(pair_first), flat->node_id(pair_second)};
+            // A measurement error, its cluster spans both rounds
+            if (chained && (round == 3 || round == 4))
+                defects = {{DecodingGraphNode::ANCILLA, round, flat->node_id(between).id}};
+            decoder.push_round(defects);
+            held->push_back(static_cast<int>(decoder.m_clusters.size()));
+        }
+        decoder.finish();
+    }
+    int peeled = 0;
+    while (peeled < T && held_alone[peeled] > 0)
+        peeled++;
+    check(peeled > 0 && peeled < T, "the cluster of a pair of defects was held for " + to_string(peeled) +
+          " of " + to_string(T) + " rounds");
+    check(peeled < T && held_chained[peeled] == 2,
+          "the cluster of a pair of defects was peeled while a cluster in between was kept");
+    for (int round = 4; round < T; round++)
+    {
+        check(held_chained[round] != 1, "round " + to_string(round) + ": the cluster of a pair of defects was " +
+              "peeled before the cluster in between");
+    }
+    check(held_chained.back() == 0, "the chained clusters were never peeled");
+
+    CountingDecoder adaptive(adaptive_args);
+    CountingDecoder lasting(unordered_map<string, string>{{"cluster_lifetime", to_string(2 * T)}});
+    long long adaptive_clusters = 0, lasting_clusters = 0;
+    for (int shot = 0; shot < 100; shot++)
+    {
+        const auto error_edges = sample_shot_edges(*graph, *flat, 0.01, shot);
+        flat->reset();
+        flat->mark(error_edges);
+        const auto marked_nodes_by_round = flat->marked_nodes_by_round();
+
+        for (const auto& [decoder, clusters] : {pair{&adaptive, &adaptive_clusters},
+                                                pair{&lasting, &lasting_clusters}})
+        {
+            // ClAYG peels round by round, so a later cluster may correct an edge again and cancel the correction
+            vector<uint8_t> remaining(flat->node_count());
+            auto apply = [&](const vector<int>& edges)
+            {
+                for (const int edge : edges)
+                {
+                    for (const int node : {flat->edge_nodes(edge).first, flat->edge_nodes(edge).second})
+                        remaining[node] ^= !flat->is_virtual(node);
+                }
+            };
+            apply(error_edges);
+            decoder->begin(*flat);
+            for (int round = 0; round < T; round++)
+            {
+                vector<DecodingGraphNode::Id> defects;
+                for (const int node : marked_nodes_by_round[round])
+                    defects.push_back(flat->node_id(node));
+                apply(decoder->push_round(defects).correction_indices);
+                *clusters += static_cast<long long>(decoder->m_clusters.size());
+            }
+            apply(decoder->finish().correction_indices);
+            for (int node = 0; node < flat->node_count(); node++)
+            {
+                if (remaining[node])
+                {
+                    check(false, "shot " + to_string(shot) + " " + decoder->decoder_name() + ": node " +
+                          to_string(node) + " is left with a defect");
+                    break;
+                }
+            }
+        }
+    }
+    check(adaptive_clusters < lasting_clusters, "adaptive lifetime held " + to_string(adaptive_clusters) +
+          " clusters over all rounds, a lifetime of " + to_string(2 * T) + " rounds " + to_string(lasting_clusters));
+
+    return report_checks();
+}
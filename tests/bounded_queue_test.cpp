@@ -0,0 +1,68 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "BoundedQueue.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Passes values from a producer thread to a consumer thread through small queues and checks that they arrive
+// once each and in order, that a full queue holds the producer back until the consumer pops, and that popping
+// leaves nothing of a value behind in the queue.
+int main()
+{
+    // Values arrive in the order they were pushed, across many wrap-arounds of the slots
+    for (const size_t capacity : {1, 3, 64})
+    {
+        const int values = 100000;
+        BoundedQueue<int> queue(capacity);
+        thread producer([&]
+        {
+            for (int value = 0; value < values; value++)
+                queue.push(value);
+        });
+        int out_of_order = 0;
+        for (int expected = 0; expected < values; expected++)
+            out_of_order += queue.pop() != expected;
+        producer.join();
+        check(out_of_order == 0, "capacity " + to_string(capacity) + ": " + to_string(out_of_order) +
+              " values arrived out of order");
+    }
+
+    // A full queue holds the producer back
+    {
+        const size_t capacity = 4;
+        BoundedQueue<int> queue(capacity);
+        atomic<size_t> pushed{0};
+        thread producer([&]
+        {
+            for (size_t value = 0; value <= capacity; value++)
+            {
+                queue.push(static_cast<int>(value));
+                pushed++;
+            }
+        });
+        while (pushed < capacity)
+            this_thread::yield();
+        this_thread::sleep_for(chrono::milliseconds(20));
+        check(pushed == capacity, to_string(pushed) + " values pushed into a queue of " + to_string(capacity));
+        check(queue.pop() == 0, "the first value pushed is not popped first");
+        producer.join();
+        check(pushed == capacity + 1, "popping did not let the producer push on");
+    }
+
+    // Popped values are moved out of their slot
+    {
+        BoundedQueue<shared_ptr<int>> queue(2);
+        auto value = make_shared<int>(1);
+        queue.push(value);
+        const auto popped = queue.pop();
+        check(popped == value && value.use_count() == 2, "the queue still holds a popped value");
+    }
+
+    return report_checks();
+}
@@ -0,0 +1,53 @@
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Decodes sampled shots with ClAYG and checks that no edge is left with negative growth. Peeling a cluster
+// resets its bulk edges and takes back the growth of its boundary, so a boundary entry that kept growing
+// after its leaf node joined through it would push the bulk edge below zero.
+int main()
+{
+    const int D = 5;
+    const int shots = 200;
+    for (const string code_name : {"rotated_surface_code", "surface_code"})
+    {
+        auto graph = DecodingGraph::from_code_name(code_name, D, D);
+        ClAYGDecoder clayg;
+        ClAYGDecoder clayg_two_rounds(unordered_map<string, string>{{"growth_rounds", "2"}});
+        SingleLayerClAYGDecoder sl_clayg;
+        const vector<ClAYGDecoder*> decoders = {&clayg, &clayg_two_rounds, &sl_clayg};
+        for (int shot = 0; shot < shots; shot++)
+        {
+            const auto error_edges = sample_shot_edges(*graph, 0.05, shot);
+
+            for (ClAYGDecoder* decoder : decoders)
+            {
+                graph->reset();
+                graph->mark(error_edges);
+                decoder->decode(graph);
+
+                const auto& decoding_graph = decoder->decoding_graph();
+                for (int edge = 0; edge < decoding_graph.edge_count(); edge++)
+                {
+                    if (decoding_graph.growth(edge) < 0)
+                    {
+                        check(false, code_name + " shot " + to_string(shot) + " " + decoder->decoder_name() +
+                              ": edge " + to_string(edge) + " has negative growth " +
+                              to_string(decoding_graph.growth(edge)));
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    return report_checks();
+}
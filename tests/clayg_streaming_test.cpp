@@ -0,0 +1,89 @@
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+namespace
+{
+using EdgeKey = tuple<int, int, int>;
+
+EdgeKey key(const DecodingGraphEdge::Id& id)
+{
+    return {id.type, id.round, id.id};
+}
+}
+
+// Streams the defects of sampled shots round by round into ClAYG, started from the code name only, and checks
+// that the corrections are those of decoding the whole graph at once, in the same order. Corrections of a
+// round only touch rounds that have been pushed, and once the last round was pushed, further rounds are ignored.
+int main()
+{
+    const int D = 5;
+    const int shots = 100;
+    for (const string code_name : {"rotated_surface_code", "surface_code"})
+    {
+        auto graph = DecodingGraph::from_code_name(code_name, D, D);
+        const auto flat = graph->flat();
+        ClAYGDecoder clayg;
+        SingleLayerClAYGDecoder sl_clayg;
+        ClAYGDecoder streaming_clayg;
+        SingleLayerClAYGDecoder streaming_sl_clayg;
+        const vector<pair<ClAYGDecoder*, ClAYGDecoder*>> decoders = {
+            {&clayg, &streaming_clayg},
+            {&sl_clayg, &streaming_sl_clayg},
+        };
+        for (int shot = 0; shot < shots; shot++)
+        {
+            const auto error_edges = sample_shot_edges(*graph, 0.03, shot);
+            graph->reset();
+            graph->mark(error_edges);
+            const auto defects_by_round = flat->marked_nodes_by_round();
+
+            for (const auto& [decoder, streaming] : decoders)
+            {
+                const string name = code_name + " shot " + to_string(shot) + " " + decoder->decoder_name();
+                const auto result = decoder->decode(*flat);
+                vector<EdgeKey> expected;
+                for (const int edge : result.correction_indices)
+                    expected.push_back(key(flat->edge_id(edge)));
+                check(static_cast<int>(result.round_latencies.size()) == D + 1,
+                      name + ": no latency for every round and the final flush");
+
+                streaming->begin(code_name, D, D);
+                vector<EdgeKey> streamed;
+                for (int round = 0; round < D && !streaming->stopped(); round++)
+                {
+                    vector<DecodingGraphNode::Id> defects;
+                    for (const int node : defects_by_round[round])
+                        defects.push_back(flat->node_id(node));
+                    const auto partial = streaming->push_round(defects);
+                    check(partial.latency >= 0, name + ": negative latency");
+                    for (const int edge : partial.correction_indices)
+                    {
+                        const auto id = streaming->decoding_graph().edge_id(edge);
+                        check(id.round <= round, name + ": round " + to_string(round) +
+                              " corrected an edge of round " + to_string(id.round));
+                        streamed.push_back(key(id));
+                    }
+                }
+                for (const int edge : streaming->finish().correction_indices)
+                    streamed.push_back(key(streaming->decoding_graph().edge_id(edge)));
+                check(streamed == expected, name + ": streamed corrections differ");
+
+                check(streaming->stopped(), name + ": stream did not stop after its last round");
+                const auto ignored = streaming->push_round({{DecodingGraphNode::ANCILLA, D, 0}});
+                check(ignored.correction_indices.empty(), name + ": round after the last one was decoded");
+            }
+        }
+    }
+
+    return report_checks();
+}
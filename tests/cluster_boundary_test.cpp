@@ -0,0 +1,102 @@
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Cluster.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+namespace
+{
+// Union-find decoder whose growth steps are run one by one, so the boundaries can be inspected in between
+class SteppingDecoder : public UnionFindDecoder
+{
+public:
+    using UnionFindDecoder::m_clusters;
+
+    void start(FlatDecodingGraph& graph)
+    {
+        cluster_pool_.release_all(m_clusters);
+        for (int node = 0; node < graph.node_count(); node++)
+        {
+            if (!graph.marked(node))
+                continue;
+            auto cluster = cluster_pool_.acquire(node, graph);
+            add_cluster(cluster);
+            graph.add_cluster(node, cluster.get());
+            cluster->add_marked_node();
+        }
+    }
+};
+}
+
+// Grows the clusters of sampled shots step by step and checks the compacted boundaries after every growth step:
+// every entry leads from a node of its cluster to a node outside of it unless the leaf node joined through the
+// edge, no other edge is listed twice, and the growth of every edge is the sum of the growth its boundary entries
+// gave it, so dropping an entry took its growth back.
+int main()
+{
+    const int D = 5;
+    const int shots = 100;
+    for (const string code_name : {"rotated_surface_code", "surface_code"})
+    {
+        auto graph = DecodingGraph::from_code_name(code_name, D, D);
+        const auto flat = graph->flat();
+        SteppingDecoder decoder;
+        for (int shot = 0; shot < shots; shot++)
+        {
+            const auto error_edges = sample_shot_edges(*graph, 0.05, shot);
+            graph->reset();
+            graph->mark(error_edges);
+
+            decoder.start(*flat);
+            for (int step = 0; !Cluster::all_clusters_are_neutral(decoder.m_clusters); step++)
+            {
+                const auto fusion_edges = decoder.grow_clusters(*flat, decoder.m_clusters);
+                const string name = code_name + " shot " + to_string(shot) + " step " + to_string(step);
+
+                vector<int> boundary_growth(flat->edge_count());
+                for (const auto& cluster : decoder.m_clusters)
+                {
+                    const auto& boundary = cluster->boundary();
+                    set<int> edges;
+                    set<pair<int, int>> bulk_entries;
+                    for (int i = 0; i < boundary.size(); i++)
+                    {
+                        const int edge = boundary.edges[i];
+                        boundary_growth[edge] += boundary.growth_from_tree[i];
+                        if (cluster->is_neutral())
+                            continue;
+                        check(flat->cluster(boundary.tree_nodes[i]) == cluster.get(),
+                              name + ": boundary entry starts outside of its cluster");
+                        if (flat->is_bulk_edge(edge))
+                        {
+                            check(bulk_entries.emplace(edge, boundary.tree_nodes[i]).second,
+                                  name + ": bulk edge " + to_string(edge) + " is listed twice from the same node");
+                            continue;
+                        }
+                        check(flat->cluster(boundary.leaf_nodes[i]) != cluster.get(),
+                              name + ": edge " + to_string(edge) + " leads back into its cluster");
+                        check(edges.insert(edge).second, name + ": edge " + to_string(edge) + " is listed twice");
+                    }
+                }
+                for (int edge = 0; edge < flat->edge_count(); edge++)
+                    check(flat->growth(edge) == boundary_growth[edge],
+                          name + ": edge " + to_string(edge) + " has growth " + to_string(flat->growth(edge))
+                          + ", its boundary entries gave it " + to_string(boundary_growth[edge]));
+
+                decoder.merge(*flat, fusion_edges);
+            }
+        }
+        check(decoder.boundary_stats().dropped_edges > 0, code_name + ": no boundary edge was ever dropped");
+    }
+
+    return report_checks();
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "Cluster.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+namespace
+{
+// Edges of the boundary of `cluster` in the order of their ranks
+vector<int> ranked_edges(const Cluster& cluster)
+{
+    const auto& boundary = cluster.boundary();
+    vector<int> order(boundary.size());
+    iota(order.begin(), order.end(), 0);
+    ranges::sort(order, {}, [&](const int i) { return boundary.ranks[i]; });
+    vector<int> edges;
+    for (const int i : order)
+        edges.push_back(boundary.edges[i]);
+    return edges;
+}
+}
+
+// Merges the cluster of the tree node of a fusion edge with another cluster both ways round, once absorbing the
+// other cluster and once being absorbed by it, and checks that the merged cluster takes its sequence number and
+// peeling start from the tree side and ranks the boundary of the tree side first either way, as union by size
+// must not change which fusion edges are reported first and where peeling starts.
+int main()
+{
+    auto graph = DecodingGraph::rotated_surface_code(5, 5);
+    const auto flat = graph->flat();
+    const int tree_root = flat->node({DecodingGraphNode::ANCILLA, 1, 2});
+    const int other_root = flat->node({DecodingGraphNode::ANCILLA, 3, 9});
+    int virtual_node = 0;
+    while (!flat->is_virtual(virtual_node))
+        virtual_node++;
+
+    // Which of the two clusters has joined the virtual node
+    for (const int with_virtual : {-1, 0, 1})
+    {
+        auto make_cluster = [&](const int root, const int side, const long long sequence)
+        {
+            Cluster cluster(root, *flat);
+            cluster.set_sequence(sequence);
+            if (side == with_virtual)
+            {
+                cluster.add_node(virtual_node);
+                cluster.add_virtual_node(virtual_node);
+            }
+            // A leaf join after the cluster was created is ranked after the edges of its root
+            cluster.add_boundary_edge({root, flat->other_node(flat->incident_edges(root)[0], root),
+                                       flat->incident_edges(root)[0]});
+            return cluster;
+        };
+        const string name = with_virtual < 0 ? "no virtual node"
+                                             : with_virtual == 0 ? "virtual tree side" : "virtual other side";
+
+        Cluster absorbing = make_cluster(tree_root, 0, 5);
+        Cluster absorbed_other = make_cluster(other_root, 1, 2);
+        absorbing.merge(absorbed_other);
+        Cluster absorbed = make_cluster(other_root, 1, 2);
+        Cluster absorbed_tree = make_cluster(tree_root, 0, 5);
+        absorbed.merge(absorbed_tree, true);
+
+        check(absorbing.sequence() == 5 && absorbed.sequence() == 5,
+              name + ": merged clusters have sequence numbers " + to_string(absorbing.sequence()) + " and " +
+              to_string(absorbed.sequence()) + " instead of that of the tree side");
+        const int peel_start = with_virtual < 0 ? tree_root : virtual_node;
+        check(absorbing.peel_start() == peel_start && absorbed.peel_start() == peel_start,
+              name + ": peeling starts from " + to_string(absorbing.peel_start()) + " and " +
+              to_string(absorbed.peel_start()) + " instead of " + to_string(peel_start));
+        const auto edges = ranked_edges(absorbing);
+        check(edges == ranked_edges(absorbed), name + ": boundaries are ranked differently after the merges");
+        const auto tree_side_edges = make_cluster(tree_root, 0, 5).boundary().edges;
+        check(vector(edges.begin(), edges.begin() + static_cast<long>(tree_side_edges.size())) == tree_side_edges,
+              name + ": the boundary of the tree side is not ranked first");
+        check(absorbing.size() == absorbed.size() && absorbing.marked_count() == absorbed.marked_count(),
+              name + ": merged clusters differ in size");
+    }
+
+    return report_checks();
+}
@@ -0,0 +1,83 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "Cluster.h"
+#include "ClusterPool.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Checks that a cluster handed out again by the pool is a new cluster of its root with nothing left of its
+// previous use, and that decoders hardly allocate for shots they have decoded a few times before, while still
+// decoding them as on their first pass.
+int main()
+{
+    auto graph = DecodingGraph::rotated_surface_code(5, 5);
+    const auto flat = graph->flat();
+
+    // A recycled cluster is reset to its new root
+    {
+        ClusterPool pool;
+        auto cluster = pool.acquire(0, *flat);
+        cluster->add_marked_node();
+        cluster->add_node(1);
+        cluster->add_bulk_edge(0);
+        cluster->set_index(3);
+        Cluster* recycled = cluster.get();
+        pool.release(move(cluster));
+        const int root = flat->node({DecodingGraphNode::ANCILLA, 2, 6});
+        cluster = pool.acquire(root, *flat);
+        check(cluster.get() == recycled, "released cluster was not handed out again");
+        check(cluster->root() == root && cluster->nodes() == vector{root} && cluster->edges().empty()
+              && cluster->marked_count() == 0 && cluster->index() == -1,
+              "recycled cluster kept state of its previous use");
+        check(cluster->boundary().size() == static_cast<int>(flat->incident_edges(root).size()),
+              "recycled cluster does not start with the edges of its root as boundary");
+        check(cluster->first_round() == 2 && cluster->last_round() == 2, "recycled cluster spans the wrong rounds");
+        check(pool.stats().clusters == 2 && pool.stats().allocations == 1,
+              "pool allocated " + to_string(pool.stats().allocations) + " times for 2 clusters");
+    }
+
+    // Decoding the same shots again hardly allocates
+    vector<vector<shared_ptr<DecodingGraphEdge>>> shots;
+    for (int shot = 0; shot < 100; shot++)
+        shots.push_back(sample_shot_edges(*graph, 0.04, shot));
+    UnionFindDecoder uf;
+    ClAYGDecoder clayg;
+    for (UnionFindDecoder* decoder : {&uf, static_cast<UnionFindDecoder*>(&clayg)})
+    {
+        vector<vector<int>> first_pass;
+        for (const auto& error_edges : shots)
+        {
+            graph->reset();
+            graph->mark(error_edges);
+            first_pass.push_back(decoder->decode(graph).correction_indices);
+        }
+        // Clusters come back in another order every pass, so each of them needs a few passes to reach the
+        // capacity of the largest cluster it is used for
+        for (int pass = 1; pass <= 4; pass++)
+        {
+            const auto before = decoder->cluster_pool_stats();
+            for (size_t shot = 0; shot < shots.size(); shot++)
+            {
+                graph->reset();
+                graph->mark(shots[shot]);
+                check(decoder->decode(graph).correction_indices == first_pass[shot],
+                      decoder->decoder_name() + " shot " + to_string(shot) + ": recycled clusters decode differently");
+            }
+            const auto& after = decoder->cluster_pool_stats();
+            if (pass == 4)
+                check(100 * (after.allocations - before.allocations) < after.clusters - before.clusters,
+                      decoder->decoder_name() + ": " + to_string(after.allocations - before.allocations) +
+                      " allocations for " + to_string(after.clusters - before.clusters) + " clusters");
+        }
+    }
+
+    return report_checks();
+}
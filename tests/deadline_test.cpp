@@ -0,0 +1,90 @@
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Decodes sampled shots with ClAYG growing three times per round under deadlines of one growth step and of one
+// nanosecond, and checks that the growth they defer is reported for every round, grows by at most the steps a
+// round could not afford, and that their corrections still clear every defect. A deadline every round meets
+// changes nothing.
+int main()
+{
+    const int D = 5;
+    const int shots = 200;
+    ClAYGDecoder unlimited(unordered_map<string, string>{{"growth_rounds", "3"}});
+    ClAYGDecoder met(unordered_map<string, string>{{"growth_rounds", "3"}, {"deadline_steps", "3"}});
+    ClAYGDecoder steps(unordered_map<string, string>{{"growth_rounds", "3"}, {"deadline_steps", "1"}});
+    ClAYGDecoder nanoseconds(unordered_map<string, string>{{"growth_rounds", "3"}, {"deadline_ns", "1"}});
+    int steps_backlogs = 0, nanoseconds_backlogs = 0;
+
+    auto graph = DecodingGraph::rotated_surface_code(D, D);
+    const auto flat = graph->flat();
+    for (int shot = 0; shot < shots; shot++)
+    {
+        const auto error_edges = sample_shot_edges(*graph, *flat, 0.04, shot);
+        flat->reset();
+        flat->mark(error_edges);
+        const string name = "shot " + to_string(shot);
+
+        const auto expected = unlimited.decode(*flat);
+        check(expected.round_backlogs.empty(), name + ": backlogs reported without a deadline");
+        const auto met_result = met.decode(*flat);
+        check(met_result.correction_indices == expected.correction_indices,
+              name + ": a deadline that every round meets changed the corrections");
+        for (const int backlog : met_result.round_backlogs)
+            check(backlog == 0, name + ": growth deferred under a deadline that every round meets");
+
+        for (const auto& [decoder, backlogs] : {pair{&steps, &steps_backlogs},
+                                                pair{&nanoseconds, &nanoseconds_backlogs}})
+        {
+            const auto result = decoder->decode(*flat);
+            const string decoder_name = name + " " + decoder->decoder_name();
+            check(static_cast<int>(result.round_backlogs.size()) == D,
+                  decoder_name + ": " + to_string(result.round_backlogs.size()) + " backlogs for " + to_string(D) +
+                  " rounds");
+            int previous = 0;
+            for (const int backlog : result.round_backlogs)
+            {
+                // A round owes its own three steps on top of the backlog of the round before
+                check(backlog >= 0 && backlog <= previous + 3, decoder_name + ": backlog of " + to_string(backlog) +
+                      " after a backlog of " + to_string(previous));
+                *backlogs += backlog > 0;
+                previous = backlog;
+            }
+
+            // ClAYG peels round by round, so a later cluster may correct an edge again and cancel the correction
+            vector<uint8_t> remaining(flat->node_count());
+            for (const int edge : error_edges)
+            {
+                for (const int node : {flat->edge_nodes(edge).first, flat->edge_nodes(edge).second})
+                    remaining[node] ^= !flat->is_virtual(node);
+            }
+            for (const int edge : result.correction_indices)
+            {
+                for (const int node : {flat->edge_nodes(edge).first, flat->edge_nodes(edge).second})
+                    remaining[node] ^= !flat->is_virtual(node);
+            }
+            for (int node = 0; node < flat->node_count(); node++)
+            {
+                if (remaining[node])
+                {
+                    check(false, decoder_name + ": node " + to_string(node) + " is left with a defect");
+                    break;
+                }
+            }
+        }
+    }
+    check(steps_backlogs > 0, "a deadline of one growth step deferred no growth");
+    check(nanoseconds_backlogs > 0, "a deadline of one nanosecond deferred no growth");
+
+    return report_checks();
+}
@@ -0,0 +1,84 @@
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "DisjointSetForest.h"
+#include "RandomStream.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Unites random pairs of elements and checks the forest against a plain array of set labels: elements share a
+// root exactly when they share a label, sizes add up, and the larger set keeps its root.
+int main()
+{
+    const int N = 500;
+    DisjointSetForest forest(N);
+    for (int x = 0; x < N; x++)
+        check(!forest.contains(x), "element " + to_string(x) + " is in the forest before make_set");
+
+    for (int run = 0; run < 2; run++)
+    {
+        vector<int> label(N);
+        iota(label.begin(), label.end(), 0);
+        for (int x = 0; x < N; x++)
+            forest.make_set(x);
+
+        RandomStream rng(1, {static_cast<uint64_t>(run)});
+        for (int step = 0; step < 2 * N; step++)
+        {
+            const int a = static_cast<int>(rng() % N);
+            const int b = static_cast<int>(rng() % N);
+            const int root_a = forest.find(a);
+            const int root_b = forest.find(b);
+            const int size_a = forest.size(root_a);
+            const int size_b = forest.size(root_b);
+            const int root = forest.unite(a, b);
+            if (root_a == root_b)
+            {
+                check(root == root_a && forest.size(root) == size_a, "uniting a set with itself changed it");
+                continue;
+            }
+            check(root == (size_a >= size_b ? root_a : root_b), "the smaller set kept its root");
+            check(forest.size(root) == size_a + size_b, "sizes do not add up");
+
+            const int old_label = label[b];
+            for (int& l : label)
+                if (l == old_label)
+                    l = label[a];
+        }
+
+        for (int x = 0; x < N; x++)
+        {
+            check(forest.contains(x), "element " + to_string(x) + " left the forest");
+            // root() does not compress paths but has to agree with find()
+            check(forest.root(x) == forest.find(x), "root() and find() differ for " + to_string(x));
+            for (int y = x + 1; y < N; y += 7)
+                check((forest.find(x) == forest.find(y)) == (label[x] == label[y]),
+                      "elements " + to_string(x) + " and " + to_string(y) + " are in the wrong sets");
+        }
+        int total = 0;
+        for (int x = 0; x < N; x++)
+            if (forest.find(x) == x)
+                total += forest.size(x);
+        check(total == N, "set sizes do not add up to the number of elements");
+
+        // Dissolving the set of element 0 takes all of its elements out of the forest
+        const int root = forest.find(0);
+        vector<int> members;
+        for (int x = 0; x < N; x++)
+            if (forest.find(x) == root)
+                members.push_back(x);
+        for (const int x : members)
+            forest.remove(x);
+        for (const int x : members)
+            check(!forest.contains(x), "element " + to_string(x) + " is still in the forest after remove");
+
+        forest.reset();
+        for (int x = 0; x < N; x++)
+            check(!forest.contains(x), "element " + to_string(x) + " is in the forest after reset");
+    }
+
+    return report_checks();
+}
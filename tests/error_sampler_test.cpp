@@ -0,0 +1,116 @@
+#include <bit>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "DecodingGraph.h"
+#include "RandomStream.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Checks that the geometric-skip sampler makes every edge faulty independently with the probability of its
+// type: per-edge frequencies and the number of errors per shot match p within a few standard deviations, also
+// at low p and for every realisation of sample_error_batch(). Rounds past sample_T are never sampled.
+int main()
+{
+    // Whether a frequency of `count` in `trials` trials is within 5 standard deviations of probability `p`
+    auto plausible = [](const double count, const double trials, const double p)
+    {
+        return abs(count - trials * p) <= 5 * sqrt(trials * p * (1 - p)) + 1e-9;
+    };
+
+    const auto graph = DecodingGraph::rotated_surface_code(3, 3);
+    const auto edges = graph->edges();
+    const map<DecodingGraphEdge::Type, double> noise_model = {
+        {DecodingGraphEdge::NORMAL, 1.0},
+        {DecodingGraphEdge::MEASUREMENT, 0.25},
+    };
+    auto edge_p = [&](const double p, const int edge)
+    {
+        return p * noise_model.at(edges[edge]->type());
+    };
+
+    // Per-edge frequencies
+    {
+        const double p = 0.2;
+        const int shots = 20000;
+        vector<int> counts(edges.size());
+        for (int shot = 0; shot < shots; shot++)
+        {
+            RandomStream rng(1, {static_cast<uint64_t>(shot)});
+            for (const auto& id : graph->sample_errors(p, noise_model, -1, rng))
+                counts[graph->edge(id).value()->index()]++;
+        }
+        for (size_t edge = 0; edge < edges.size(); edge++)
+            check(plausible(counts[edge], shots, edge_p(p, static_cast<int>(edge))),
+                  "edge " + to_string(edge) + " was faulty in " + to_string(counts[edge]) + " of " +
+                  to_string(shots) + " shots");
+    }
+
+    // Number of errors per shot at low p, where the sampler skips most edges
+    {
+        const double p = 1e-3;
+        const int shots = 200000;
+        double expected = 0;
+        for (size_t edge = 0; edge < edges.size(); edge++)
+            expected += edge_p(p, static_cast<int>(edge));
+        long long errors = 0;
+        for (int shot = 0; shot < shots; shot++)
+        {
+            RandomStream rng(2, {static_cast<uint64_t>(shot)});
+            errors += static_cast<long long>(graph->sample_errors(p, noise_model, -1, rng).size());
+        }
+        check(abs(errors - shots * expected) <= 5 * sqrt(shots * expected),
+              to_string(errors) + " errors in " + to_string(shots) + " shots, expected " +
+              to_string(shots * expected));
+    }
+
+    // Every realisation of a batch has the same per-edge frequencies
+    {
+        const double p = 0.1;
+        const int batches = 500;
+        vector<vector<int>> counts(64, vector<int>(edges.size()));
+        for (int batch = 0; batch < batches; batch++)
+        {
+            RandomStream rng(3, {static_cast<uint64_t>(batch)});
+            for (const auto& [id, mask] : graph->sample_error_batch(p, noise_model, -1, rng))
+            {
+                check(mask != 0, "batch reported an edge that is faulty in no realisation");
+                for (uint64_t lanes = mask; lanes != 0; lanes &= lanes - 1)
+                    counts[countr_zero(lanes)][graph->edge(id).value()->index()]++;
+            }
+        }
+        for (int lane = 0; lane < 64; lane++)
+        {
+            int lane_errors = 0;
+            double expected = 0;
+            for (size_t edge = 0; edge < edges.size(); edge++)
+            {
+                lane_errors += counts[lane][edge];
+                expected += edge_p(p, static_cast<int>(edge));
+            }
+            check(plausible(lane_errors, batches * static_cast<double>(edges.size()), expected / edges.size()),
+                  "realisation " + to_string(lane) + " has " + to_string(lane_errors) + " errors in " +
+                  to_string(batches) + " batches");
+        }
+    }
+
+    // Certain errors hit every edge exactly once, and sample_T limits the rounds
+    {
+        RandomStream rng(4, {});
+        vector<int> counts(edges.size());
+        for (const auto& id : graph->sample_errors(1.0, UNIFORM_NOISE, -1, rng))
+            counts[graph->edge(id).value()->index()]++;
+        for (size_t edge = 0; edge < edges.size(); edge++)
+            check(counts[edge] == 1, "edge " + to_string(edge) + " was faulty " + to_string(counts[edge]) +
+                  " times at p = 1");
+        for (const auto& id : graph->sample_errors(1.0, UNIFORM_NOISE, 1, rng))
+            check(id.round == 0, "sample_T = 1 sampled an edge of round " + to_string(id.round));
+        check(graph->sample_errors(0.0, UNIFORM_NOISE, -1, rng).empty(), "p = 0 sampled errors");
+    }
+
+    return report_checks();
+}
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Checks that the flat view of every code has the nodes, edges and adjacency of its DecodingGraph, that ids
+// resolve to the same indices in both, and that marks set on the DecodingGraph are mirrored into the flat view.
+int main()
+{
+    for (const string code_name : {"repetition_code", "rotated_surface_code", "surface_code"})
+    {
+        auto graph = DecodingGraph::from_code_name(code_name, 5, 4);
+        const auto flat = graph->flat();
+        const auto nodes = graph->nodes();
+        const auto edges = graph->edges();
+        check(flat->node_count() == static_cast<int>(nodes.size()), code_name + ": node count differs");
+        check(flat->edge_count() == static_cast<int>(edges.size()), code_name + ": edge count differs");
+        check(flat->code_name() == code_name && flat->d() == 5 && flat->t() == 4,
+              code_name + ": code, distance or rounds differ");
+
+        for (int node = 0; node < flat->node_count(); node++)
+        {
+            const auto id = nodes[node]->id();
+            check(nodes[node]->index() == node && flat->node_id(node) == id && flat->node(id) == node,
+                  code_name + ": node " + to_string(node) + " does not resolve to its index");
+            check(flat->is_virtual(node) == (id.type == DecodingGraphNode::VIRTUAL),
+                  code_name + ": node " + to_string(node) + " has the wrong type");
+            check(flat->incident_edges(node).size() == nodes[node]->edges().size(),
+                  code_name + ": node " + to_string(node) + " has the wrong degree");
+            for (size_t i = 0; i < flat->incident_edges(node).size(); i++)
+            {
+                const int edge = flat->incident_edges(node)[i];
+                check(flat->other_node(edge, node) == flat->neighbors(node)[i],
+                      code_name + ": neighbour " + to_string(i) + " of node " + to_string(node) + " is wrong");
+            }
+        }
+
+        for (int edge = 0; edge < flat->edge_count(); edge++)
+        {
+            const auto id = edges[edge]->id();
+            const auto [first, second] = flat->edge_nodes(edge);
+            check(edges[edge]->index() == edge && flat->edge(id) == edge,
+                  code_name + ": edge " + to_string(edge) + " does not resolve to its index");
+            check(flat->edge_type(edge) == id.type && flat->edge_id(edge).round == id.round
+                  && flat->edge_id(edge).id == id.id,
+                  code_name + ": edge " + to_string(edge) + " has the wrong id");
+            check(first == edges[edge]->nodes().first.lock()->index()
+                  && second == edges[edge]->nodes().second.lock()->index(),
+                  code_name + ": edge " + to_string(edge) + " has the wrong nodes");
+            const auto incident = flat->incident_edges(first);
+            check(ranges::find(incident, edge) != incident.end(),
+                  code_name + ": edge " + to_string(edge) + " is missing from the adjacency of its node");
+            check(flat->growth(edge) == 0 && flat->weight(edge) == GROWTH_UNITS,
+                  code_name + ": edge " + to_string(edge) + " does not start empty");
+        }
+
+        // Marks are mirrored into the flat view and undone by reset()
+        graph->mark({edges[0], edges[edges.size() / 2]});
+        for (int node = 0; node < flat->node_count(); node++)
+            check(flat->marked(node) == nodes[node]->marked(),
+                  code_name + ": mark of node " + to_string(node) + " is not mirrored");
+        graph->reset();
+        for (int node = 0; node < flat->node_count(); node++)
+            check(!flat->marked(node), code_name + ": node " + to_string(node) + " is still marked after reset");
+    }
+
+    bool threw = false;
+    try
+    {
+        DecodingGraph::from_code_name("color_code", 5, 5);
+    }
+    catch (const runtime_error&)
+    {
+        threw = true;
+    }
+    check(threw, "from_code_name accepted an unsupported code");
+
+    return report_checks();
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "GrowthKernel.h"
+#include "RandomStream.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Runs every kernel this CPU supports on random boundaries of many lengths, including lengths that are not a
+// multiple of any vector width, and checks growth, growth from the tree and fused bits against adding the growth
+// edge by edge. Kernels the CPU lacks are skipped and reported.
+int main()
+{
+    check(GrowthKernel::is_supported("auto") && GrowthKernel::is_supported("scalar"),
+          "auto or scalar kernel is not supported");
+    check(!GrowthKernel::is_supported("sse9"), "unknown kernel is supported");
+
+    const int EDGES = 2000;
+    for (const string kernel : {"scalar", "avx2", "avx512", "auto"})
+    {
+        if (!GrowthKernel::is_supported(kernel))
+        {
+            cout << "skipping the " << kernel << " kernel, this CPU does not support it" << endl;
+            continue;
+        }
+        GrowthKernel::select(kernel);
+        check(kernel == "auto" || GrowthKernel::selected() == kernel, kernel + ": another kernel was selected");
+
+        for (const int count : {0, 1, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 500, 1999})
+        {
+            RandomStream rng(1, {static_cast<uint64_t>(count)});
+            // Distinct edges in random order, growth and weights with padding after the last edge
+            vector<int> all_edges(EDGES);
+            iota(all_edges.begin(), all_edges.end(), 0);
+            shuffle(all_edges.begin(), all_edges.end(), rng);
+            const vector<int> edges(all_edges.begin(), all_edges.begin() + count);
+            vector<Growth> increments(count), growth(EDGES + 1), weight(EDGES + 1), growth_from_tree(count);
+            for (int i = 0; i < count; i++)
+            {
+                increments[i] = static_cast<Growth>(rng() % (GROWTH_UNITS + 1));
+                growth_from_tree[i] = static_cast<Growth>(rng() % GROWTH_UNITS);
+            }
+            for (int edge = 0; edge < EDGES; edge++)
+            {
+                weight[edge] = static_cast<Growth>(GROWTH_UNITS / 2 * (1 + rng() % 4));
+                growth[edge] = static_cast<Growth>(rng() % (weight[edge] + 1));
+            }
+
+            auto expected_growth = growth;
+            auto expected_from_tree = growth_from_tree;
+            vector<uint64_t> expected_fused((count + 63) / 64);
+            for (int i = 0; i < count; i++)
+            {
+                expected_growth[edges[i]] = static_cast<Growth>(expected_growth[edges[i]] + increments[i]);
+                expected_from_tree[i] = static_cast<Growth>(expected_from_tree[i] + increments[i]);
+                if (expected_growth[edges[i]] >= weight[edges[i]])
+                    expected_fused[i / 64] |= uint64_t{1} << (i % 64);
+            }
+
+            vector<uint64_t> fused((count + 63) / 64);
+            GrowthKernel::grow(edges.data(), increments.data(), count, growth.data(), weight.data(),
+                               growth_from_tree.data(), fused.data());
+            const string name = kernel + " kernel, " + to_string(count) + " edges";
+            check(growth == expected_growth, name + ": growth differs");
+            check(growth_from_tree == expected_from_tree, name + ": growth from the tree differs");
+            check(fused == expected_fused, name + ": fused edges differ");
+        }
+    }
+
+    return report_checks();
+}
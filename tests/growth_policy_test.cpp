@@ -0,0 +1,77 @@
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Cluster.h"
+#include "FlatDecodingGraph.h"
+#include "GrowthPolicy.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+namespace
+{
+// Growth each policy gives to an edge from `start` to `end`, as the policies document it
+Growth expected_growth(const string& policy, const DecodingGraphNode::Id& start, const DecodingGraphNode::Id& end,
+                       const DecodingGraphEdge::Type type)
+{
+    if (policy == "third")
+        return GROWTH_UNITS / 3;
+    if (policy == "faster_backwards")
+        return start.round > end.round ? GROWTH_UNITS : GROWTH_UNITS / 2;
+    if (policy == "normal=0.25,measurement=0.75")
+        return type == DecodingGraphEdge::NORMAL ? GROWTH_UNITS / 4 : GROWTH_UNITS * 3 / 4;
+    return GROWTH_UNITS / 2;
+}
+}
+
+// Grows a single-node cluster in the middle of the graph with every growth policy, selected through the decoder
+// arguments, and checks the growth of each of its edges after every step and that edges fuse in the step in which
+// they reach their weight.
+int main()
+{
+    const auto graph = FlatDecodingGraph::overlay("rotated_surface_code", 5, 5);
+    const int node = graph->node({DecodingGraphNode::ANCILLA, 2, 6});
+    check(graph->incident_edges(node).size() >= 4, "node in the middle of the graph has too few edges");
+
+    for (const string policy : {"uniform", "third", "faster_backwards", "normal=0.25,measurement=0.75"})
+    {
+        UnionFindDecoder decoder({{"growth_policy", policy}});
+        graph->reset();
+        const auto cluster = make_shared<Cluster>(node, *graph);
+        graph->add_cluster(node, cluster.get());
+        cluster->add_marked_node();
+
+        vector<int> fused_at(graph->edge_count(), -1);
+        for (int step = 1; step <= 4; step++)
+        {
+            for (const auto& fusion_edge : decoder.grow(*graph, cluster))
+            {
+                // Fused edges stay on the boundary until they are merged, which is left out here
+                if (fused_at[fusion_edge.edge] == -1)
+                    fused_at[fusion_edge.edge] = step;
+            }
+            for (const int edge : graph->incident_edges(node))
+            {
+                const int other = graph->other_node(edge, node);
+                const Growth growth = expected_growth(policy, graph->node_id(node), graph->node_id(other),
+                                                      graph->edge_type(edge));
+                const int steps_to_fuse = (GROWTH_UNITS + growth - 1) / growth;
+                if (step > steps_to_fuse)
+                    continue;
+                check(graph->growth(edge) == step * growth,
+                      policy + ": edge " + to_string(edge) + " has growth " + to_string(graph->growth(edge)) +
+                      " after step " + to_string(step));
+                check(fused_at[edge] == (step == steps_to_fuse ? step : -1),
+                      policy + ": edge " + to_string(edge) + " fused at step " + to_string(fused_at[edge]) +
+                      " instead of " + to_string(steps_to_fuse));
+            }
+        }
+        graph->remove_from_cluster(node);
+    }
+
+    return report_checks();
+}
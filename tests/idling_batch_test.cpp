@@ -0,0 +1,65 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DecodingGraph.h"
+#include "LogicalComputer.h"
+#include "RandomStream.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Checks that the bit-sliced compute_idling_failures() counts as many failures as calling compute() once per
+// idling realisation, with the realisations taken from the same batches of the same stream. 100 runs cover a
+// full and a partial batch of 64.
+int main()
+{
+    const int D = 5;
+    const int shots = 100;
+    const int runs = 100;
+
+    for (const string code_name : {"repetition_code", "rotated_surface_code", "surface_code"})
+    {
+        auto graph = DecodingGraph::from_code_name(code_name, D, D);
+        LogicalComputer batched(graph);
+        LogicalComputer single(graph);
+        UnionFindDecoder decoder;
+        for (int shot = 0; shot < shots; shot++)
+        {
+            const auto error_edges = sample_shot_edges(*graph, 0.03, shot);
+            graph->reset();
+            graph->mark(error_edges);
+            const auto result = decoder.decode(graph);
+
+            for (const double p_idling : {0.01, 0.1})
+            {
+                RandomStream batched_rng(1, {static_cast<uint64_t>(shot), RandomStream::IDLING});
+                const int batched_failures = batched.compute_idling_failures(
+                    error_edges, result, p_idling, UNIFORM_NOISE, runs, batched_rng);
+
+                RandomStream single_rng(1, {static_cast<uint64_t>(shot), RandomStream::IDLING});
+                int single_failures = 0;
+                for (int start = 0; start < runs; start += 64)
+                {
+                    const auto batch = graph->sample_error_batch(p_idling, UNIFORM_NOISE, 1, single_rng);
+                    for (int lane = 0; lane < 64 && start + lane < runs; lane++)
+                    {
+                        vector<shared_ptr<DecodingGraphEdge>> idling_edges;
+                        for (const auto& [id, mask] : batch)
+                            if (mask >> lane & 1)
+                                idling_edges.push_back(graph->edge(id).value());
+                        single_failures += single.compute(error_edges, idling_edges, result);
+                    }
+                }
+
+                check(batched_failures == single_failures, code_name + " shot " + to_string(shot) + " p_idling " +
+                      to_string(p_idling) + ": " + to_string(batched_failures) + " failures in batches, " +
+                      to_string(single_failures) + " one by one");
+            }
+        }
+    }
+
+    return report_checks();
+}
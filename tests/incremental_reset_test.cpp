@@ -0,0 +1,68 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Decodes sampled shots on one graph that is only reset between them, and checks that every reset leaves no
+// mark, cluster, growth or bulk edge behind, and that every shot is decoded as on a graph that was never used.
+int main()
+{
+    const int D = 5;
+    const int shots = 200;
+    // Whether `graph` is as cleared as a graph that was never used
+    auto cleared = [](const FlatDecodingGraph& graph)
+    {
+        for (int node = 0; node < graph.node_count(); node++)
+            if (graph.marked(node) || graph.cluster(node) != nullptr)
+                return false;
+        for (int edge = 0; edge < graph.edge_count(); edge++)
+            if (graph.growth(edge) != 0 || graph.is_bulk_edge(edge))
+                return false;
+        return true;
+    };
+
+    for (const string code_name : {"rotated_surface_code", "surface_code"})
+    {
+        auto graph = DecodingGraph::from_code_name(code_name, D, D);
+        const auto flat = graph->flat();
+        UnionFindDecoder uf;
+        ClAYGDecoder clayg;
+        for (int shot = 0; shot < shots; shot++)
+        {
+            const auto error_edges = sample_shot_edges(*graph, 0.05, shot);
+            vector<int> error_indices;
+            for (const auto& edge : error_edges)
+                error_indices.push_back(edge->index());
+
+            // ClAYG decodes on a working graph that it resets itself, union-find on the graph itself, where
+            // peeling clears the marks
+            graph->reset();
+            check(cleared(*flat), code_name + " shot " + to_string(shot) + ": reset left state behind");
+            graph->mark(error_edges);
+            const auto clayg_result = clayg.decode(graph);
+            const auto uf_result = uf.decode(graph);
+
+            const auto fresh = FlatDecodingGraph::overlay(*flat);
+            fresh->mark(error_indices);
+            UnionFindDecoder fresh_uf;
+            check(fresh_uf.decode(*fresh).correction_indices == uf_result.correction_indices,
+                  code_name + " shot " + to_string(shot) + ": uf decodes differently after a reset");
+            fresh->reset();
+            check(cleared(*fresh), code_name + " shot " + to_string(shot) + ": reset left uf state behind");
+            fresh->mark(error_indices);
+            ClAYGDecoder fresh_clayg;
+            check(fresh_clayg.decode(*fresh).correction_indices == clayg_result.correction_indices,
+                  code_name + " shot " + to_string(shot) + ": clayg decodes differently after a reset");
+        }
+    }
+
+    return report_checks();
+}
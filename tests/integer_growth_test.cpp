@@ -0,0 +1,75 @@
+#include <string>
+#include <vector>
+
+#include "Cluster.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+namespace
+{
+// Union-find decoder whose growth steps are run one by one
+class SteppingDecoder : public UnionFindDecoder
+{
+public:
+    using UnionFindDecoder::UnionFindDecoder;
+
+    // Grows the clusters of the marked nodes of `graph` until they are neutral and returns the number of steps
+    int grow_until_neutral(FlatDecodingGraph& graph)
+    {
+        cluster_pool_.release_all(m_clusters);
+        for (int node = 0; node < graph.node_count(); node++)
+        {
+            if (!graph.marked(node))
+                continue;
+            auto cluster = cluster_pool_.acquire(node, graph);
+            add_cluster(cluster);
+            graph.add_cluster(node, cluster.get());
+            cluster->add_marked_node();
+        }
+        int steps = 0;
+        for (; !Cluster::all_clusters_are_neutral(m_clusters); steps++)
+            merge(graph, grow_clusters(graph, m_clusters));
+        return steps;
+    }
+};
+}
+
+// Marks both ends of a normal edge in the middle of the graph and grows them with 1/k of an edge per step for
+// every k that growth units divide. Growing from both ends, the edge has to fuse after exactly ceil(k/2) steps
+// and hold exactly the growth of those steps, which floating-point growth missed e.g. for thirds.
+int main()
+{
+    const auto graph = FlatDecodingGraph::overlay("rotated_surface_code", 9, 1);
+    const int first = graph->node({DecodingGraphNode::ANCILLA, 0, 36});
+    int edge = -1;
+    for (const int incident : graph->incident_edges(first))
+    {
+        if (graph->edge_type(incident) == DecodingGraphEdge::NORMAL
+            && !graph->is_virtual(graph->other_node(incident, first)))
+            edge = incident;
+    }
+    const int second = graph->other_node(edge, first);
+
+    for (const int k : {1, 2, 3, 4, 5, 6, 10, 12})
+    {
+        const string fraction = to_string(1.0 / k);
+        SteppingDecoder decoder({{"growth_policy", "normal=" + fraction + ",measurement=" + fraction}});
+        graph->reset();
+        graph->set_marked(first, true);
+        graph->set_marked(second, true);
+        const int steps = decoder.grow_until_neutral(*graph);
+        const int expected_steps = (k + 1) / 2;
+        const int expected_growth = 2 * expected_steps * (GROWTH_UNITS / k);
+        check(steps == expected_steps && graph->growth(edge) == expected_growth,
+              "growth of 1/" + to_string(k) + ": fused after " + to_string(steps) + " steps with growth " +
+              to_string(graph->growth(edge)) + ", expected " + to_string(expected_steps) + " steps with growth " +
+              to_string(expected_growth));
+    }
+
+    return report_checks();
+}
@@ -0,0 +1,62 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+#include "LogicalComputer.h"
+#include "RandomStream.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Decodes sampled shots of every code and checks that LogicalComputer gives the same logical outcomes with
+// and without its lookup table. Built with AddressSanitizer, so any access outside of its per-edge arrays,
+// e.g. through the sparse edge ids of the repetition code, fails the test as well.
+int main()
+{
+    const int D = 5;
+    const int shots = 200;
+    const int runs_idling = 100;
+
+    for (const string code_name : {"repetition_code", "rotated_surface_code", "surface_code"})
+    {
+        auto graph = DecodingGraph::from_code_name(code_name, D, D);
+        LogicalComputer with_table(graph);
+        LogicalComputer without_table(graph, 0);
+        check(with_table.uses_lookup_table() || code_name == "surface_code",
+              code_name + ": expected the lookup table to be used");
+
+        vector<shared_ptr<Decoder>> decoders = {make_shared<UnionFindDecoder>(), make_shared<ClAYGDecoder>()};
+        for (int shot = 0; shot < shots; shot++)
+        {
+            const auto error_edges = sample_shot_edges(*graph, 0.03, shot);
+
+            for (const auto& decoder : decoders)
+            {
+                graph->reset();
+                graph->mark(error_edges);
+                const auto result = decoder->decode(graph);
+
+                const int expected = without_table.compute(error_edges, {}, result);
+                check(with_table.compute(error_edges, {}, result) == expected,
+                      code_name + " shot " + to_string(shot) + " " + decoder->decoder_name() +
+                      ": logical outcome differs with the lookup table");
+
+                RandomStream idling_a(1, {static_cast<uint64_t>(shot), RandomStream::IDLING});
+                RandomStream idling_b(1, {static_cast<uint64_t>(shot), RandomStream::IDLING});
+                const int idling_expected = without_table.compute_idling_failures(
+                    error_edges, result, 0.01, UNIFORM_NOISE, runs_idling, idling_a);
+                check(with_table.compute_idling_failures(error_edges, result, 0.01, UNIFORM_NOISE, runs_idling,
+                                                         idling_b) == idling_expected
+                      && idling_expected >= 0 && idling_expected <= runs_idling,
+                      code_name + " shot " + to_string(shot) + " " + decoder->decoder_name() +
+                      ": idling failures differ with the lookup table");
+            }
+        }
+    }
+
+    return report_checks();
+}
@@ -0,0 +1,49 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Decoder.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+#include "LogicalComputer.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Checks that the final readout lookup table is only used if it fits into its budget, and that it resolves the
+// final syndromes of random errors at p = 0.5, which reach every syndrome of the small codes, to the same
+// logical outcome as decoding them.
+int main()
+{
+    for (const string code_name : {"repetition_code", "rotated_surface_code", "surface_code"})
+    {
+        const auto graph = DecodingGraph::from_code_name(code_name, 3, 1);
+        // Two bits per final syndrome, one syndrome bit per node of the single layer
+        const int syndrome_bits = DecodingGraph::single_layer_copy(graph)->flat()->node_count();
+        const size_t budget = (size_t{1} << syndrome_bits) / 4;
+        check(LogicalComputer(graph, budget).uses_lookup_table(), code_name + ": table that fits is not used");
+        check(!LogicalComputer(graph, budget - 1).uses_lookup_table(),
+              code_name + ": table that does not fit is used");
+        check(!LogicalComputer(graph, 0).uses_lookup_table(), code_name + ": table is used with budget 0");
+
+        LogicalComputer with_table(graph, budget);
+        LogicalComputer without_table(graph, 0);
+        DecodingResult result;
+        result.considered_up_to_round = 0;
+        for (int shot = 0; shot < 2000; shot++)
+        {
+            const auto error_edges = sample_shot_edges(*graph, 0.5, shot);
+            check(with_table.compute(error_edges, {}, result) == without_table.compute(error_edges, {}, result),
+                  code_name + " shot " + to_string(shot) + ": logical outcome differs with the lookup table");
+        }
+        // Every syndrome was decoded once and then looked up or taken from the cache
+        check(without_table.cache_misses() <= (size_t{1} << syndrome_bits),
+              code_name + ": cache missed more often than there are syndromes");
+    }
+
+    const auto large = DecodingGraph::rotated_surface_code(9, 1);
+    check(!LogicalComputer(large).uses_lookup_table(), "the table is used for 80 ancillas and their virtual nodes");
+
+    return report_checks();
+}
@@ -0,0 +1,55 @@
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Decodes sampled shots with the clusters of each step grown on a worker pool and on the calling thread, and
+// checks that both give the same corrections in the same order after the same number of steps. The shots have
+// enough defects that the first steps of union-find are split over the threads.
+int main()
+{
+    const int D = 11;
+    const int shots = 30;
+    auto graph = DecodingGraph::rotated_surface_code(D, D);
+    const unordered_map<string, string> threads = {{"grow_threads", "3"}};
+    const vector<pair<shared_ptr<Decoder>, shared_ptr<Decoder>>> decoders = {
+        {make_shared<UnionFindDecoder>(), make_shared<UnionFindDecoder>(threads)},
+        {make_shared<ClAYGDecoder>(), make_shared<ClAYGDecoder>(threads)},
+        {make_shared<SingleLayerClAYGDecoder>(), make_shared<SingleLayerClAYGDecoder>(threads)},
+    };
+    for (int shot = 0; shot < shots; shot++)
+    {
+        const auto error_edges = sample_shot_edges(*graph, 0.03, shot);
+        graph->reset();
+        graph->mark(error_edges);
+        int defects = 0;
+        for (const auto& node : graph->nodes())
+            defects += node->marked();
+        // The first step of union-find grows one cluster per defect
+        check(defects >= 16 * 3, "shot " + to_string(shot) + " has too few defects to be split");
+
+        for (const auto& [serial, parallel] : decoders)
+        {
+            graph->reset();
+            graph->mark(error_edges);
+            const auto expected = serial->decode(graph);
+            graph->reset();
+            graph->mark(error_edges);
+            const auto result = parallel->decode(graph);
+            check(result.correction_indices == expected.correction_indices,
+                  "shot " + to_string(shot) + " " + serial->decoder_name() + ": corrections differ");
+            check(result.decoding_steps == expected.decoding_steps,
+                  "shot " + to_string(shot) + " " + serial->decoder_name() + ": decoding steps differ");
+        }
+    }
+
+    return report_checks();
+}
@@ -0,0 +1,96 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Cluster.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+#include "PeelingDecoder.h"
+#include "UnionFindDecoder.h"
+#include "WorkerPool.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+namespace
+{
+// Union-find decoder that stops before peeling, so the clusters can be peeled separately
+class GrowingDecoder : public UnionFindDecoder
+{
+public:
+    using UnionFindDecoder::m_clusters;
+
+    void grow_until_neutral(FlatDecodingGraph& graph)
+    {
+        cluster_pool_.release_all(m_clusters);
+        for (int node = 0; node < graph.node_count(); node++)
+        {
+            if (!graph.marked(node))
+                continue;
+            auto cluster = cluster_pool_.acquire(node, graph);
+            add_cluster(cluster);
+            graph.add_cluster(node, cluster.get());
+            cluster->add_marked_node();
+        }
+        while (!Cluster::all_clusters_are_neutral(m_clusters))
+            merge(graph, grow_clusters(graph, m_clusters));
+    }
+};
+}
+
+// Grows the clusters of sampled shots on two copies of the graph and peels them once on the calling thread and
+// once split over a worker pool, and checks that both give the same corrections in the same order, the same
+// number of peeling steps and the same marks. The shots have enough clusters that peeling is split.
+int main()
+{
+    const int D = 15;
+    const int shots = 20;
+    const int threads = 4;
+    // Every task of a batch runs exactly once
+    WorkerPool pool(threads);
+    vector<atomic<int>> runs(1000);
+    pool.run(static_cast<int>(runs.size()), [&](const int task) { runs[task]++; });
+    for (size_t task = 0; task < runs.size(); task++)
+        check(runs[task] == 1, "task " + to_string(task) + " ran " + to_string(runs[task]) + " times");
+
+    auto graph = DecodingGraph::rotated_surface_code(D, D);
+    const auto serial_graph = FlatDecodingGraph::overlay(*graph->flat());
+    const auto parallel_graph = FlatDecodingGraph::overlay(*graph->flat());
+    GrowingDecoder serial_growth, parallel_growth;
+    PeelingDecoder serial_peeling, parallel_peeling;
+    for (int shot = 0; shot < shots; shot++)
+    {
+        const auto error_edges = sample_shot_edges(*graph, *serial_graph, 0.02, shot);
+
+        for (const auto& [flat, growth] : {pair{serial_graph.get(), &serial_growth},
+                                           pair{parallel_graph.get(), &parallel_growth}})
+        {
+            flat->reset();
+            flat->mark(error_edges);
+            growth->grow_until_neutral(*flat);
+        }
+        int peeled_clusters = 0;
+        for (const auto& cluster : parallel_growth.m_clusters)
+            peeled_clusters += cluster->marked_count() != 0;
+        const string name = "shot " + to_string(shot);
+        check(peeled_clusters >= 8 * threads, name + ": too few clusters to split peeling");
+
+        const auto expected = serial_peeling.decode(serial_growth.m_clusters, *serial_graph);
+        const auto result = parallel_peeling.decode(parallel_growth.m_clusters, *parallel_graph, &pool);
+        check(result.correction_indices == expected.correction_indices, name + ": corrections differ");
+        check(result.decoding_steps == expected.decoding_steps, name + ": peeling steps differ");
+        for (int node = 0; node < serial_graph->node_count(); node++)
+        {
+            if (serial_graph->marked(node) != parallel_graph->marked(node))
+            {
+                check(false, name + ": node " + to_string(node) + " is marked differently after peeling");
+                break;
+            }
+        }
+    }
+
+    return report_checks();
+}
@@ -0,0 +1,68 @@
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Decodes many sampled shots with the same decoders, so their peeling scratch space is reused across epochs, and
+// checks that the corrections of every shot flip exactly the defects of its errors, i.e. that errors and
+// corrections together leave no defect, and that union-find corrects no edge twice.
+int main()
+{
+    const int D = 5;
+    const int shots = 300;
+    for (const string code_name : {"repetition_code", "rotated_surface_code", "surface_code"})
+    {
+        auto graph = DecodingGraph::from_code_name(code_name, D, D);
+        const auto flat = graph->flat();
+        // ClAYG peels round by round, so a later cluster may correct an edge again and cancel the correction
+        const vector<pair<shared_ptr<Decoder>, bool>> decoders = {
+            {make_shared<UnionFindDecoder>(), true},
+            {make_shared<ClAYGDecoder>(), false},
+        };
+        for (int shot = 0; shot < shots; shot++)
+        {
+            const auto error_edges = sample_shot_edges(*graph, *flat, 0.04, shot);
+
+            for (const auto& [decoder, corrects_once] : decoders)
+            {
+                flat->reset();
+                flat->mark(error_edges);
+                // Union-find peels on `flat` and clears its marks, so the defects are recorded first
+                vector<uint8_t> defects(flat->node_count());
+                for (int node = 0; node < flat->node_count(); node++)
+                    defects[node] = flat->marked(node);
+                const auto result = decoder->decode(*flat);
+
+                vector<uint8_t> corrected(flat->edge_count());
+                vector<uint8_t> remaining = defects;
+                for (const int edge : result.correction_indices)
+                {
+                    check(!(corrected[edge]++ && corrects_once), code_name + " shot " + to_string(shot) + " " +
+                          decoder->decoder_name() + ": edge " + to_string(edge) + " was corrected twice");
+                    for (const int node : {flat->edge_nodes(edge).first, flat->edge_nodes(edge).second})
+                        remaining[node] ^= !flat->is_virtual(node);
+                }
+                for (int node = 0; node < flat->node_count(); node++)
+                {
+                    if (remaining[node])
+                    {
+                        check(false, code_name + " shot " + to_string(shot) + " " + decoder->decoder_name() +
+                              ": node " + to_string(node) + " is left with a defect");
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    return report_checks();
+}
@@ -0,0 +1,79 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "DecodingGraph.h"
+#include "RandomStream.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+namespace
+{
+vector<uint64_t> draw(RandomStream rng, const int count)
+{
+    vector<uint64_t> values;
+    for (int i = 0; i < count; i++)
+        values.push_back(rng());
+    return values;
+}
+}
+
+// Checks that a stream only depends on its seed and keys: rebuilding it gives the same numbers no matter which
+// other streams were used before, while other seeds or keys give other numbers. Sampling errors from equal
+// streams gives equal errors.
+int main()
+{
+    const auto reference = draw(RandomStream(42, {3, 17, RandomStream::BULK}), 100);
+    // Using unrelated streams in between does not change it
+    RandomStream other(42, {3, 16, RandomStream::BULK});
+    for (int i = 0; i < 1000; i++)
+        other();
+    check(draw(RandomStream(42, {3, 17, RandomStream::BULK}), 100) == reference, "rebuilt stream differs");
+
+    check(draw(RandomStream(43, {3, 17, RandomStream::BULK}), 100) != reference, "seed does not change the stream");
+    check(draw(RandomStream(42, {3, 18, RandomStream::BULK}), 100) != reference, "shot does not change the stream");
+    check(draw(RandomStream(42, {3, 17, RandomStream::IDLING}), 100) != reference,
+          "purpose does not change the stream");
+    check(draw(RandomStream(42, {17, 3, RandomStream::BULK}), 100) != reference, "order of the keys is ignored");
+
+    // Keys of names are fixed FNV-1a hashes, so they do not change between runs or platforms
+    check(RandomStream::key("") == 0xcbf29ce484222325ULL, "key of the empty name is not the FNV-1a offset basis");
+    check(RandomStream::key("a") == 0xaf63dc4c8601ec8cULL, "key of \"a\" is not its FNV-1a hash");
+    check(RandomStream::key("uf") != RandomStream::key("clayg"), "names share a key");
+
+    // uniform() stays in [0, 1) and the stream works with the standard distributions
+    RandomStream rng(1, {});
+    double sum = 0;
+    const int N = 100000;
+    for (int i = 0; i < N; i++)
+    {
+        const double u = rng.uniform();
+        check(u >= 0 && u < 1, "uniform() left [0, 1)");
+        sum += u;
+    }
+    check(sum / N > 0.49 && sum / N < 0.51, "mean of uniform() is " + to_string(sum / N));
+    uniform_int_distribution<int> die(1, 6);
+    vector<int> counts(7);
+    for (int i = 0; i < 6000; i++)
+        counts[die(rng)]++;
+    for (int face = 1; face <= 6; face++)
+        check(counts[face] > 850 && counts[face] < 1150, "face " + to_string(face) + " came up " +
+              to_string(counts[face]) + " times in 6000 rolls");
+
+    // Errors sampled from equal streams are equal, errors of other shots are not
+    const auto graph = DecodingGraph::rotated_surface_code(5, 5);
+    auto sample = [&](const uint64_t shot)
+    {
+        RandomStream shot_rng(42, {shot, RandomStream::BULK});
+        vector<pair<int, int>> errors;
+        for (const auto& id : graph->sample_errors(0.05, UNIFORM_NOISE, -1, shot_rng))
+            errors.emplace_back(id.round, id.id);
+        return errors;
+    };
+    check(sample(1) == sample(1), "equal streams sampled different errors");
+    check(sample(1) != sample(2), "different shots sampled the same errors");
+
+    return report_checks();
+}
@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+namespace
+{
+using EdgeKey = tuple<int, int, int>;
+
+// Streams the defects of `defects_by_round` into `decoder` and returns the corrections of every call by edge id.
+// The ring buffer numbers its nodes differently, so a cluster is peeled in another order and the corrections of
+// a call are sorted.
+vector<vector<EdgeKey>> stream(ClAYGDecoder& decoder, const FlatDecodingGraph& graph,
+                               const vector<vector<int>>& defects_by_round)
+{
+    vector<vector<EdgeKey>> corrections;
+    auto append = [&](const DecodingResult& result)
+    {
+        auto& call = corrections.emplace_back();
+        for (const int edge : result.correction_indices)
+        {
+            const auto id = decoder.decoding_graph().edge_id(edge);
+            call.emplace_back(id.type, id.round, id.id);
+        }
+        ranges::sort(call);
+    };
+    decoder.begin(graph.code_name(), graph.d(), graph.t());
+    for (int round = 0; round < graph.t() && !decoder.stopped(); round++)
+    {
+        vector<DecodingGraphNode::Id> defects;
+        for (const int node : defects_by_round[round])
+            defects.push_back(graph.node_id(node));
+        append(decoder.push_round(defects));
+    }
+    append(decoder.finish());
+    return corrections;
+}
+}
+
+// Decodes long streams with ClAYG on a ring buffer and on the whole graph and checks that both give the same
+// corrections in the same rounds unless the window was too short and had to be flushed. The ring buffer has the
+// same size for streams of any length, and codes with edges that span rounds are rejected.
+int main()
+{
+    const int D = 5;
+    const int T = 60;
+    const int window = 10;
+    const int shots = 40;
+    auto graph = DecodingGraph::rotated_surface_code(D, T);
+    const auto flat = graph->flat();
+    ClAYGDecoder whole;
+    ClAYGDecoder windowed;
+    windowed.set_window(window);
+    int flushed_shots = 0;
+    for (int shot = 0; shot < shots; shot++)
+    {
+        const auto error_edges = sample_shot_edges(*graph, 0.01, shot);
+        graph->reset();
+        graph->mark(error_edges);
+        const auto defects_by_round = flat->marked_nodes_by_round();
+
+        const auto expected = stream(whole, *flat, defects_by_round);
+        const auto corrections = stream(windowed, *flat, defects_by_round);
+        check(windowed.decoding_graph().is_ring_buffer(), "window did not decode on a ring buffer");
+        if (windowed.window_flushes() > 0)
+        {
+            flushed_shots++;
+            continue;
+        }
+        check(corrections == expected, "shot " + to_string(shot) + ": corrections differ on the ring buffer");
+    }
+    check(flushed_shots < shots / 4, to_string(flushed_shots) + " of " + to_string(shots) + " shots flushed");
+
+    // The ring buffer holds `window` layers however long the stream is
+    const int layer_nodes = flat->ancilla_count_per_layer();
+    windowed.begin("rotated_surface_code", D, 100000);
+    const int ring_nodes = windowed.decoding_graph().node_count();
+    check(ring_nodes < (window + 1) * layer_nodes, "ring buffer has " + to_string(ring_nodes) + " nodes");
+    for (int round = 0; round < 1000; round++)
+        windowed.push_round({});
+    check(windowed.decoding_graph().node_count() == ring_nodes, "ring buffer grew while streaming");
+    check(windowed.window_flushes() == 0, "stream without defects flushed the window");
+
+    auto throws = [](auto f)
+    {
+        try
+        {
+            f();
+        }
+        catch (const runtime_error&)
+        {
+            return true;
+        }
+        return false;
+    };
+    check(throws([&] { FlatDecodingGraph::ring_buffer("rotated_surface_code", D, 2); }),
+          "ring buffer of 2 layers was accepted");
+    check(throws([&] { FlatDecodingGraph::ring_buffer("surface_code", D, window); }),
+          "surface code, whose spatial edges span rounds, was accepted");
+
+    return report_checks();
+}
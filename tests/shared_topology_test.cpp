@@ -0,0 +1,76 @@
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Checks that overlays share the topology of their code, distance and number of rounds but not their state, that
+// ClAYG leaves the marks of the graph it decodes untouched, and that several ClAYG decoders decoding the same
+// graph at the same time give the corrections of a single decoder.
+int main()
+{
+    const int threads = 4;
+    // Overlays of the same code, distance and number of rounds share their topology
+    const auto first = FlatDecodingGraph::overlay("rotated_surface_code", 5, 5);
+    const auto second = FlatDecodingGraph::overlay("rotated_surface_code", 5, 5);
+    check(first->shares_topology(*second), "overlays of the same code do not share their topology");
+    check(!first->shares_topology(*FlatDecodingGraph::overlay("rotated_surface_code", 7, 5)),
+          "overlays of different distances share their topology");
+    check(!first->shares_topology(*FlatDecodingGraph::overlay("rotated_surface_code", 5, 3)),
+          "overlays of different numbers of rounds share their topology");
+    check(!first->shares_topology(*FlatDecodingGraph::overlay("surface_code", 5, 5)),
+          "overlays of different codes share their topology");
+
+    // An overlay of a graph has its indices but its own state
+    auto graph = DecodingGraph::rotated_surface_code(5, 5);
+    const auto flat = graph->flat();
+    const auto overlay = FlatDecodingGraph::overlay(*flat);
+    check(overlay->shares_topology(*flat), "overlay does not share the topology of its source");
+    check(overlay->node_count() == flat->node_count() && overlay->edge_count() == flat->edge_count(),
+          "overlay has other nodes or edges than its source");
+    flat->reset();
+    flat->set_marked(3, true);
+    check(!overlay->marked(3), "marking the source marked its overlay");
+    overlay->set_marked(4, true);
+    check(!flat->marked(4), "marking the overlay marked its source");
+    overlay->reset();
+    check(flat->marked(3), "resetting the overlay reset its source");
+
+    // Decoders decode the same graph without touching it, alone or at the same time
+    ClAYGDecoder serial;
+    vector<ClAYGDecoder> decoders(threads);
+    for (int shot = 0; shot < 50; shot++)
+    {
+        const auto error_edges = sample_shot_edges(*graph, *flat, 0.04, shot);
+        flat->reset();
+        flat->mark(error_edges);
+        const auto marked_nodes = flat->marked_nodes_by_round();
+        const string name = "shot " + to_string(shot);
+
+        const auto expected = serial.decode(*flat).correction_indices;
+        check(flat->marked_nodes_by_round() == marked_nodes, name + ": decoding changed the marks of the graph");
+
+        vector<vector<int>> corrections(threads);
+        vector<thread> workers;
+        for (int worker = 0; worker < threads; worker++)
+        {
+            workers.emplace_back([&, worker]
+            {
+                corrections[worker] = decoders[worker].decode(*flat).correction_indices;
+            });
+        }
+        for (auto& worker : workers)
+            worker.join();
+        for (int worker = 0; worker < threads; worker++)
+            check(corrections[worker] == expected, name + ": decoder " + to_string(worker) + " corrects differently");
+    }
+
+    return report_checks();
+}
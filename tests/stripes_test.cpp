@@ -0,0 +1,96 @@
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Checks that splitting the layers of the codes into the stripes has_row_bands() accepts only ever connects
+// ancillas of the same or of neighbouring stripes, and that union-find, ClAYG and single-layer ClAYG grown and
+// merged on stripes correct the same edges in the same order as their serial counterparts, with every stripe doing
+// part of the work, also well below the threshold.
+int main()
+{
+    const int D = 21;
+    const int stripes = 4;
+    const int shots = 10;
+    for (const string code_name : {"repetition_code", "rotated_surface_code", "surface_code"})
+    {
+        const auto flat = FlatDecodingGraph::overlay(code_name, 15, 2);
+        int banded = 0;
+        for (int split = 1; split <= flat->ancilla_count_per_layer(); split++)
+        {
+            if (!flat->has_row_bands(split))
+                continue;
+            banded++;
+            for (int edge = 0; edge < flat->edge_count(); edge++)
+            {
+                const auto [first, second] = flat->edge_nodes(edge);
+                if (flat->is_virtual(first) || flat->is_virtual(second))
+                    continue;
+                if (abs(flat->node_stripe(first, split) - flat->node_stripe(second, split)) > 1)
+                {
+                    check(false, code_name + ": " + to_string(split) + " stripes do not give bands, edge " +
+                          to_string(edge) + " skips a stripe");
+                    break;
+                }
+            }
+        }
+        check(banded > 1, code_name + ": splits into " + to_string(banded) + " sets of bands");
+    }
+    check(!FlatDecodingGraph::overlay("rotated_surface_code", 15, 2)->has_row_bands(14),
+          "rotated surface code of distance 15 splits into bands thinner than a row");
+
+    auto graph = DecodingGraph::rotated_surface_code(D, D);
+    const auto flat = graph->flat();
+    const unordered_map<string, string> striped = {{"stripes", to_string(stripes)}};
+    // Well below the threshold ClAYG only grows a few clusters per round, near it union-find steps are large
+    for (const double p : {0.01, 0.04})
+    {
+        UnionFindDecoder uf, striped_uf(striped);
+        ClAYGDecoder clayg, striped_clayg(striped);
+        SingleLayerClAYGDecoder sl_clayg, striped_sl_clayg(striped);
+        const vector<pair<UnionFindDecoder*, UnionFindDecoder*>> decoders = {
+            {&uf, &striped_uf},
+            {&clayg, &striped_clayg},
+            {&sl_clayg, &striped_sl_clayg},
+        };
+        const string p_name = "p = " + to_string(p);
+        for (int shot = 0; shot < shots; shot++)
+        {
+            const auto error_edges = sample_shot_edges(*graph, *flat, p, shot);
+            for (const auto& [serial, parallel] : decoders)
+            {
+                vector<vector<int>> corrections;
+                for (UnionFindDecoder* decoder : {serial, parallel})
+                {
+                    flat->reset();
+                    flat->mark(error_edges);
+                    corrections.push_back(decoder->decode(*flat).correction_indices);
+                }
+                check(corrections[0] == corrections[1], p_name + " shot " + to_string(shot) + " " +
+                      serial->decoder_name() + ": stripes correct differently");
+            }
+        }
+        for (const auto& [serial, parallel] : decoders)
+        {
+            const string name = p_name + " " + parallel->decoder_name();
+            check(static_cast<int>(parallel->stripe_load().size()) == stripes,
+                  name + ": load of " + to_string(parallel->stripe_load().size()) + " stripes");
+            for (int stripe = 0; stripe < static_cast<int>(parallel->stripe_load().size()); stripe++)
+                check(parallel->stripe_load()[stripe] > 0, name + ": stripe " + to_string(stripe) + " grew nothing");
+            check(serial->stripe_load().empty(), name + ": load reported without stripes");
+        }
+    }
+
+    return report_checks();
+}
@@ -0,0 +1,59 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Decoder.h"
+#include "DecodingGraph.h"
+#include "LogicalComputer.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Checks the syndrome cache of LogicalComputer without a lookup table: a repeated syndrome is a hit with the
+// same outcome, clear_cache() forgets all syndromes, and once more syndromes than the cache holds have been seen,
+// the least recently used one has been evicted while the most recent one is still cached.
+int main()
+{
+    // 48 ancillas, so random errors at p = 0.3 practically never repeat a syndrome
+    const auto graph = DecodingGraph::rotated_surface_code(7, 1);
+    LogicalComputer logical_computer(graph, 0);
+    DecodingResult result;
+    result.considered_up_to_round = 0;
+    auto errors_of_shot = [&](const int shot) { return sample_shot_edges(*graph, 0.3, shot); };
+
+    // More shots than the cache holds
+    const int shots = 10100;
+    vector<int> outcomes;
+    for (int shot = 0; shot < shots; shot++)
+        outcomes.push_back(logical_computer.compute(errors_of_shot(shot), {}, result));
+    check(logical_computer.cache_misses() > 10000, "random syndromes were taken from the cache");
+
+    // The most recent syndrome is cached with its outcome
+    size_t hits = logical_computer.cache_hits();
+    check(logical_computer.compute(errors_of_shot(shots - 1), {}, result) == outcomes.back(),
+          "outcome of a cached syndrome differs");
+    check(logical_computer.cache_hits() == hits + 1, "most recent syndrome is not cached");
+
+    // The least recently used syndrome was evicted, and is decoded to the same outcome again
+    size_t misses = logical_computer.cache_misses();
+    check(logical_computer.compute(errors_of_shot(0), {}, result) == outcomes.front(),
+          "outcome of an evicted syndrome differs");
+    check(logical_computer.cache_misses() == misses + 1, "least recently used syndrome was not evicted");
+
+    // A syndrome that is used again stays cached while newer ones arrive
+    hits = logical_computer.cache_hits();
+    for (int shot = 1; shot < 100; shot++)
+    {
+        logical_computer.compute(errors_of_shot(shots - 1), {}, result);
+        logical_computer.compute(errors_of_shot(shots + shot), {}, result);
+    }
+    check(logical_computer.cache_hits() == hits + 99, "recently used syndrome was evicted");
+
+    logical_computer.clear_cache();
+    misses = logical_computer.cache_misses();
+    logical_computer.compute(errors_of_shot(shots - 1), {}, result);
+    check(logical_computer.cache_misses() == misses + 1, "syndrome is still cached after clear_cache()");
+
+    return report_checks();
+}
@@ -0,0 +1,70 @@
+#ifndef CLAYG_TEST_SUPPORT_H
+#define CLAYG_TEST_SUPPORT_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+#include "RandomStream.h"
+
+// Number of checks that failed so far
+inline int failures = 0;
+
+// Reports `what` if `ok` is false
+inline void check(const bool ok, const std::string& what)
+{
+    if (!ok)
+    {
+        std::cerr << what << std::endl;
+        failures++;
+    }
+}
+
+// Exit code of a test: 1 if any check failed
+inline int report_checks()
+{
+    if (failures > 0)
+    {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
+
+// Data and measurement errors, both with probability p
+inline const std::map<DecodingGraphEdge::Type, double> UNIFORM_NOISE = {
+    {DecodingGraphEdge::NORMAL, 1.0},
+    {DecodingGraphEdge::MEASUREMENT, 1.0},
+};
+
+// Errors of a shot, drawn from the bulk stream of `shot` under seed 1
+inline std::vector<std::shared_ptr<DecodingGraphEdge>> sample_shot_edges(
+    DecodingGraph& graph, const double p, const uint64_t shot,
+    const std::map<DecodingGraphEdge::Type, double>& noise_model = UNIFORM_NOISE)
+{
+    RandomStream rng(1, {shot, RandomStream::BULK});
+    std::vector<std::shared_ptr<DecodingGraphEdge>> error_edges;
+    for (const auto& id : graph.sample_errors(p, noise_model, -1, rng))
+        error_edges.push_back(graph.edge(id).value());
+    return error_edges;
+}
+
+// Errors of a shot as edge indices of `flat`, a flat view of `graph` or an overlay of it
+inline std::vector<int> sample_shot_edges(
+    const DecodingGraph& graph, const FlatDecodingGraph& flat, const double p, const uint64_t shot,
+    const std::map<DecodingGraphEdge::Type, double>& noise_model = UNIFORM_NOISE)
+{
+    RandomStream rng(1, {shot, RandomStream::BULK});
+    std::vector<int> error_edges;
+    for (const auto& id : graph.sample_errors(p, noise_model, -1, rng))
+        error_edges.push_back(flat.edge(id));
+    return error_edges;
+}
+
+#endif //CLAYG_TEST_SUPPORT_H
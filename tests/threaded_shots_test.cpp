@@ -0,0 +1,79 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ClAYGDecoder.h"
+#include "DecodingGraph.h"
+#include "LogicalComputer.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+namespace
+{
+const int D = 5;
+const int SHOTS = 300;
+const double P = 0.03;
+// Graph, decoders and logical computer of one thread, as in the shot workers of the driver
+struct Worker
+{
+    shared_ptr<DecodingGraph> graph = DecodingGraph::rotated_surface_code(D, D);
+    vector<shared_ptr<Decoder>> decoders = {make_shared<UnionFindDecoder>(), make_shared<ClAYGDecoder>()};
+    LogicalComputer logical_computer{graph};
+
+    // Logical outcome and decoding steps of every decoder for shot number `shot`
+    vector<pair<int, double>> run(const int shot)
+    {
+        const auto error_edges = sample_shot_edges(*graph, P, shot);
+
+        vector<pair<int, double>> outcomes;
+        for (const auto& decoder : decoders)
+        {
+            graph->reset();
+            graph->mark(error_edges);
+            const auto result = decoder->decode(graph);
+            outcomes.emplace_back(logical_computer.compute(error_edges, {}, result), result.decoding_steps);
+        }
+        return outcomes;
+    }
+};
+}
+
+// Runs shots on several threads that take shot numbers from a shared counter, each with a worker of its own, and
+// checks that every shot has the same outcome as when all shots run on a single thread.
+int main()
+{
+    vector<vector<pair<int, double>>> serial(SHOTS);
+    Worker serial_worker;
+    for (int shot = 0; shot < SHOTS; shot++)
+        serial[shot] = serial_worker.run(shot);
+
+    const int threads = 4;
+    vector<vector<pair<int, double>>> threaded(SHOTS);
+    vector<unique_ptr<Worker>> workers;
+    for (int t = 0; t < threads; t++)
+        workers.push_back(make_unique<Worker>());
+    atomic<int> next_shot{0};
+    vector<thread> worker_threads;
+    for (int t = 0; t < threads; t++)
+    {
+        worker_threads.emplace_back([&, t]
+        {
+            for (int shot = next_shot++; shot < SHOTS; shot = next_shot++)
+                threaded[shot] = workers[t]->run(shot);
+        });
+    }
+    for (auto& worker_thread : worker_threads)
+        worker_thread.join();
+
+    for (int shot = 0; shot < SHOTS; shot++)
+    {
+        check(threaded[shot] == serial[shot],
+              "shot " + to_string(shot) + " has a different outcome on " + to_string(threads) + " threads");
+    }
+
+    return report_checks();
+}
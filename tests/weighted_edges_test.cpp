@@ -0,0 +1,70 @@
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DecodingGraph.h"
+#include "FlatDecodingGraph.h"
+#include "LogicalComputer.h"
+#include "UnionFindDecoder.h"
+
+#include "test_support.h"
+
+using namespace std;
+
+// Checks the log-likelihood weights that weighted union-find gives the edges of a noise model with rare
+// measurement errors, that unweighted union-find and noise at p >= 0.5 keep weight 1, and that the weights make
+// union-find fail less often on shots of that noise model.
+int main()
+{
+    const double p = 0.04;
+    const map<DecodingGraphEdge::Type, double> noise_model = {
+        {DecodingGraphEdge::NORMAL, 1.0},
+        {DecodingGraphEdge::MEASUREMENT, 0.1},
+    };
+    auto graph = DecodingGraph::rotated_surface_code(5, 5);
+    const auto flat = graph->flat();
+    int normal_edge = -1, measurement_edge = -1;
+    for (int edge = 0; edge < flat->edge_count(); edge++)
+        (flat->edge_type(edge) == DecodingGraphEdge::NORMAL ? normal_edge : measurement_edge) = edge;
+
+    UnionFindDecoder weighted(unordered_map<string, string>{{"weighted", "true"}});
+    UnionFindDecoder unweighted;
+    weighted.set_noise(p, noise_model);
+    unweighted.set_noise(p, noise_model);
+
+    // The most likely edges keep weight 1, the others weigh log((1-p_e)/p_e) relative to them in half edges
+    weighted.decode(*flat);
+    const double half_edges = round(2 * log((1 - p * 0.1) / (p * 0.1)) / log((1 - p) / p));
+    check(flat->weight(normal_edge) == GROWTH_UNITS, "normal edges do not keep weight 1");
+    check(flat->weight(measurement_edge) == half_edges * GROWTH_UNITS / 2,
+          "measurement edges weigh " + to_string(flat->weight(measurement_edge)) + " instead of " +
+          to_string(half_edges * GROWTH_UNITS / 2));
+    unweighted.decode(*flat);
+    check(flat->weight(measurement_edge) == GROWTH_UNITS, "unweighted union-find left the weights in place");
+    weighted.set_noise(0.6, noise_model);
+    weighted.decode(*flat);
+    check(flat->weight(normal_edge) == GROWTH_UNITS && flat->weight(measurement_edge) == GROWTH_UNITS,
+          "noise at p >= 0.5 is weighted");
+    weighted.set_noise(p, noise_model);
+
+    LogicalComputer logical_computer(graph);
+    int weighted_failures = 0, unweighted_failures = 0;
+    for (int shot = 0; shot < 1000; shot++)
+    {
+        const auto error_edges = sample_shot_edges(*graph, p, shot, noise_model);
+        for (auto [decoder, decoder_failures] : {pair{&weighted, &weighted_failures},
+                                                 pair{&unweighted, &unweighted_failures}})
+        {
+            graph->reset();
+            graph->mark(error_edges);
+            *decoder_failures += logical_computer.compute(error_edges, {}, decoder->decode(graph));
+        }
+    }
+    check(weighted_failures < unweighted_failures, "weighted union-find failed " + to_string(weighted_failures) +
+          " times, unweighted " + to_string(unweighted_failures) + " times");
+
+    return report_checks();
+}
@@ -3,8 +3,8 @@
 #SBATCH --output=stdout/slurm-%x-%A_%a.out
 #SBATCH --error=stderr/slurm-%x-%A_%a.err
 #SBATCH --time=28:00:00
-#SBATCH --cpus-per-task=1
-#SBATCH --mem=2G
+#SBATCH --cpus-per-task=8 # Shot worker threads, override with sbatch --cpus-per-task=N
+#SBATCH --mem=4G # Every worker holds its own decoders
 #SBATCH --array=0-27 # Set to number of lines in params.txt minus 1
 
 CWD="$(pwd)"
@@ -26,4 +26,4 @@ echo "[$SLURM_ARRAY_TASK_ID] D=$DIST, T=$ROUNDS, (prob $P_START→$P_END $P_STEP
     --p_start "${P_START}" --p_end "${P_END}" --p_step "${P_STEP}" \
     --idling_time_constant_start "$IDL_START" --idling_time_constant_end "$IDL_END" --idling_time_constant_step "$IDL_STEP" \
     --dump false --runs_p "$RUNS_P" --runs_idling "$RUNS_IDLING" \
-    --noise_model "$NOISE_MODEL"
+    --noise_model "$NOISE_MODEL" --threads "${SLURM_CPUS_PER_TASK:-1}"